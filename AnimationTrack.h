@@ -0,0 +1,268 @@
+#pragma once
+
+#include "Animation.h"
+#include "Time.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// The animated scalars of a Transform, each compressed independently
+enum class Channel : unsigned {
+    TranslationX,
+    TranslationY,
+    TranslationZ,
+    ScaleX,
+    ScaleY,
+    ScaleZ,
+    Rotation,
+};
+
+constexpr unsigned ChannelCount = 7;
+
+struct Keyframe {
+    float time;
+    float value;
+};
+
+// Uncompressed per channel keyframes, linearly interpolated between keys. Keys are expected on a
+// grid of frameTime seconds, which is what lets compression store their times exactly.
+struct RawTrack {
+    Seconds duration;
+    float frameTime = 1.0f / 60.0f;
+    std::array<std::vector<Keyframe>, ChannelCount> channels;
+
+    void add(Seconds time, const Transform& transform) {
+        const float values[ChannelCount] = {
+            transform.translation.x,
+            transform.translation.y,
+            transform.translation.z,
+            transform.scale.x,
+            transform.scale.y,
+            transform.scale.z,
+            transform.rotation,
+        };
+        for (unsigned i = 0; i < ChannelCount; i++) {
+            channels[i].push_back({time.value, values[i]});
+        }
+        duration = std::max(duration.value, time.value);
+    }
+
+    // Bakes an eased animation frame into keys at a fixed rate. A zero duration bakes the end pose.
+    static RawTrack sample(const AnimationFrame& frame, Seconds duration, float rate) {
+        RawTrack track;
+        unsigned count = std::max(2u, static_cast<unsigned>(std::ceil(duration.value * rate)) + 1);
+        track.frameTime = duration.value / (count - 1);
+        for (unsigned i = 0; i < count; i++) {
+            Seconds time = duration.value * i / (count - 1);
+            Seconds alpha = duration.value > 0.0f ? time / duration : Seconds(1.0f);
+
+            Transform transform;
+            transform.translation =
+                Easing::apply(frame.easing, frame.start.translation, frame.end.translation, alpha);
+            transform.scale =
+                Easing::apply(frame.easing, frame.start.scale, frame.end.scale, alpha);
+            transform.rotation =
+                Easing::apply(frame.easing, frame.start.rotation, frame.end.rotation, alpha);
+            track.add(time, transform);
+        }
+        return track;
+    }
+
+    size_t byteSize() const {
+        size_t bytes = 0;
+        for (auto& channel : channels) bytes += channel.size() * sizeof(Keyframe);
+        return bytes;
+    }
+};
+
+// Keys are stored per channel as 16 bit frame indices and 16 bit values relative to the channel's
+// range, after dropping every key that interpolating the stored neighbours reproduces within the
+// tolerance. A channel whose range is too wide for 16 bit steps to leave room for reduction keeps
+// full floats instead.
+struct CompressedTrack {
+    struct ChannelRange {
+        float minimum;
+        float extent;
+        uint32_t first;
+        uint32_t count;
+        // Where the channel's keys start in values, or in wideValues for a wide channel
+        uint32_t valueFirst;
+        bool wide;
+    };
+
+    Seconds duration;
+    float frameTime = 0.0f;
+    std::array<ChannelRange, ChannelCount> ranges;
+    std::vector<uint16_t> times;
+    std::vector<uint16_t> values;
+    std::vector<float> wideValues;
+
+    float time(uint32_t key) const { return times[key] * frameTime; }
+
+    float value(unsigned channel, uint32_t key) const {
+        auto& range = ranges[channel];
+        uint32_t index = range.valueFirst + (key - range.first);
+        if (range.wide) return wideValues[index];
+        return range.minimum + values[index] * (range.extent / 65535.0f);
+    }
+
+    size_t byteSize() const {
+        return sizeof(*this) + (times.size() + values.size()) * sizeof(uint16_t) +
+               wideValues.size() * sizeof(float);
+    }
+
+    // Compresses so that, for keys on the raw track's frame grid, no sampled value strays further
+    // than tolerance from the raw curve. Frame indices are exact, and the error is measured on the
+    // quantised values, so the bound holds for what is actually stored. Both curves are linear
+    // between raw keys, so checking at the raw keys covers every time in between.
+    static CompressedTrack compress(const RawTrack& raw, float tolerance) {
+        CompressedTrack track;
+        track.duration = raw.duration;
+
+        // Tracks longer than 65535 frames fall back to a coarser grid, their times are then rounded
+        float frames = raw.frameTime > 0.0f ? raw.duration.value / raw.frameTime : 0.0f;
+        track.frameTime = frames > 65535.0f ? raw.duration.value / 65535.0f : raw.frameTime;
+
+        for (unsigned c = 0; c < ChannelCount; c++) {
+            auto& keys = raw.channels[c];
+            auto& range = track.ranges[c];
+            range = {0.0f, 0.0f, static_cast<uint32_t>(track.times.size()), 0, 0, false};
+            if (keys.empty()) continue;
+
+            auto [low, high] = std::minmax_element(keys.begin(), keys.end(),
+                [](const Keyframe& a, const Keyframe& b) { return a.value < b.value; });
+            range.minimum = low->value;
+            range.extent = high->value - low->value;
+
+            // Half a 16 bit step is the rounding error of every stored key. Past a quarter of the
+            // tolerance too little is left for dropping keys, so the channel keeps floats.
+            range.wide = range.extent / 65535.0f * 0.5f > tolerance * 0.25f;
+            range.valueFirst = range.wide ? track.wideValues.size() : track.values.size();
+
+            std::vector<uint16_t> frameOf(keys.size());
+            std::vector<float> storedTime(keys.size());
+            std::vector<uint16_t> quantized(keys.size());
+            std::vector<float> storedValue(keys.size());
+            for (size_t i = 0; i < keys.size(); i++) {
+                frameOf[i] = track.frameIndex(keys[i].time);
+                storedTime[i] = frameOf[i] * track.frameTime;
+                quantized[i] = quantize(keys[i].value, range.minimum, range.extent);
+                float step = range.extent / 65535.0f;
+                storedValue[i] = range.wide ? keys[i].value : range.minimum + quantized[i] * step;
+            }
+
+            std::vector<bool> keep(keys.size(), false);
+            keep.front() = keep.back() = true;
+            reduce(keys, storedTime, storedValue, 0, keys.size() - 1, tolerance, keep);
+
+            for (size_t i = 0; i < keys.size(); i++) {
+                if (!keep[i]) continue;
+                track.times.push_back(frameOf[i]);
+                if (range.wide) {
+                    track.wideValues.push_back(keys[i].value);
+                } else {
+                    track.values.push_back(quantized[i]);
+                }
+            }
+            range.count = track.times.size() - range.first;
+        }
+
+        return track;
+    }
+
+  private:
+    uint16_t frameIndex(float time) const {
+        if (frameTime <= 0.0f) return 0;
+        return static_cast<uint16_t>(std::clamp(std::lround(time / frameTime), 0l, 65535l));
+    }
+
+    static uint16_t quantize(float value, float minimum, float extent) {
+        if (extent <= 0.0f) return 0;
+        float normalized = std::clamp((value - minimum) / extent, 0.0f, 1.0f);
+        return static_cast<uint16_t>(std::lround(normalized * 65535.0f));
+    }
+
+    // Keeps the raw key that interpolating the stored first and last keys reproduces worst, then
+    // recurses on both halves, until every dropped key is within tolerance
+    static void reduce(const std::vector<Keyframe>& keys, const std::vector<float>& times,
+        const std::vector<float>& values, size_t first, size_t last, float tolerance,
+        std::vector<bool>& keep) {
+        if (last <= first + 1) return;
+
+        float start = times[first];
+        float span = times[last] - start;
+
+        size_t worst = first;
+        float worstError = 0.0f;
+        for (size_t i = first + 1; i < last; i++) {
+            float alpha = span > 0.0f ? (keys[i].time - start) / span : 0.0f;
+            alpha = std::clamp(alpha, 0.0f, 1.0f);
+            float error = std::fabs(values[first] + (values[last] - values[first]) * alpha -
+                                    keys[i].value);
+            if (error > worstError) {
+                worstError = error;
+                worst = i;
+            }
+        }
+
+        if (worstError <= tolerance) return;
+
+        keep[worst] = true;
+        reduce(keys, times, values, first, worst, tolerance, keep);
+        reduce(keys, times, values, worst, last, tolerance, keep);
+    }
+};
+
+// Samples a compressed track by remembering the current key of every channel. Playback moving
+// forward in time only steps over the keys it passes, seeking backwards restarts from the front.
+struct TrackCursor {
+    const CompressedTrack* track;
+    std::array<uint32_t, ChannelCount> keys = {};
+    float last = 0.0f;
+
+    TrackCursor(const CompressedTrack& track) : track(&track) { reset(); }
+
+    void reset() {
+        for (unsigned c = 0; c < ChannelCount; c++) keys[c] = track->ranges[c].first;
+        last = 0.0f;
+    }
+
+    Transform sample(Seconds time) {
+        if (time.value < last) reset();
+        last = time.value;
+
+        Transform transform;
+        transform.translation = {
+            sample(0, time.value), sample(1, time.value), sample(2, time.value)};
+        transform.scale = {sample(3, time.value), sample(4, time.value), sample(5, time.value)};
+        transform.rotation = sample(6, time.value);
+        return transform;
+    }
+
+  private:
+    // Only steps forward, so it has to stay behind the public sample, which resets on a seek back
+    float sample(unsigned channel, float time) {
+        auto& range = track->ranges[channel];
+        if (range.count == 0) {
+            bool isScale =
+                channel >= unsigned(Channel::ScaleX) && channel <= unsigned(Channel::ScaleZ);
+            return isScale ? 1.0f : 0.0f;
+        }
+
+        uint32_t end = range.first + range.count - 1;
+        uint32_t& key = keys[channel];
+        while (key < end && track->time(key + 1) <= time) key++;
+
+        if (key == end) return track->value(channel, key);
+
+        float start = track->time(key);
+        float span = track->time(key + 1) - start;
+        float alpha = span > 0.0f ? std::clamp((time - start) / span, 0.0f, 1.0f) : 0.0f;
+        float a = track->value(channel, key);
+        float b = track->value(channel, key + 1);
+        return a + (b - a) * alpha;
+    }
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+// Forwards to another resource while counting the allocations that reach it. Used as the upstream
+// of the frame arenas so a steady state frame can be shown to never touch the heap.
+class CountingResource : public std::pmr::memory_resource {
+    std::pmr::memory_resource* upstream;
+    std::atomic<size_t> allocations = 0;
+    std::atomic<size_t> bytes = 0;
+
+  public:
+    CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream(upstream) {}
+
+    size_t allocationCount() const { return allocations.load(std::memory_order_relaxed); }
+
+    size_t allocatedBytes() const { return bytes.load(std::memory_order_relaxed); }
+
+  private:
+    void* do_allocate(size_t size, size_t alignment) override {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+        return upstream->allocate(size, alignment);
+    }
+
+    void do_deallocate(void* pointer, size_t size, size_t alignment) override {
+        upstream->deallocate(pointer, size, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// A linear allocator over a list of blocks. Allocation bumps a pointer, deallocation is a no-op and
+// everything is released at once by reset, which keeps the blocks for the next frame. Once the
+// arena has grown to a frame's peak usage, later frames allocate nothing from upstream.
+class FrameArena : public std::pmr::memory_resource {
+    struct Block {
+        uint8_t* data;
+        size_t size;
+    };
+
+    std::pmr::memory_resource* upstream;
+    std::vector<Block> blocks;
+    size_t blockSize;
+    size_t current = 0;
+    size_t head = 0;
+    size_t peak = 0;
+
+  public:
+    // Position to rewind to, for stack style scopes inside a frame
+    struct Marker {
+        size_t block;
+        size_t head;
+    };
+
+    FrameArena(size_t blockSize = 1 << 20,
+        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream(upstream), blockSize(blockSize) {}
+
+    ~FrameArena() {
+        for (auto& block : blocks) {
+            upstream->deallocate(block.data, block.size, alignof(std::max_align_t));
+        }
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    Marker mark() const { return {current, head}; }
+
+    void rewind(Marker marker) {
+        current = marker.block;
+        head = marker.head;
+    }
+
+    // Releases every allocation made since the last reset
+    void reset() {
+        peak = std::max(peak, used());
+        current = 0;
+        head = 0;
+    }
+
+    size_t used() const {
+        size_t total = head;
+        for (size_t i = 0; i < current && i < blocks.size(); i++) total += blocks[i].size;
+        return total;
+    }
+
+    size_t peakUsage() const { return std::max(peak, used()); }
+
+    size_t reserved() const {
+        size_t total = 0;
+        for (auto& block : blocks) total += block.size;
+        return total;
+    }
+
+    template <typename T, typename... Args> T* make(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        return new (memory) T(std::forward<Args>(args)...);
+    }
+
+  private:
+    void* do_allocate(size_t size, size_t alignment) override {
+        while (current < blocks.size()) {
+            auto& block = blocks[current];
+            size_t start = (reinterpret_cast<uintptr_t>(block.data) + head + alignment - 1) /
+                               alignment * alignment -
+                           reinterpret_cast<uintptr_t>(block.data);
+
+            if (start + size <= block.size) {
+                head = start + size;
+                return block.data + start;
+            }
+
+            current++;
+            head = 0;
+        }
+
+        // Out of blocks, grow by one large enough for this request
+        size_t bytes = std::max(blockSize, size + alignment);
+        auto data = static_cast<uint8_t*>(upstream->allocate(bytes, alignof(std::max_align_t)));
+        blocks.push_back({data, bytes});
+        current = blocks.size() - 1;
+        head = 0;
+        return do_allocate(size, alignment);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// One frame arena per thread, all drawing from a shared counting upstream. Threads allocate from
+// their own arena without locking, endFrame resets every arena once the frame's work is joined.
+// Only the arenas are counted, pmr containers built on any other resource are not seen.
+class FrameAllocator {
+    CountingResource counter;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<FrameArena>> arenas;
+    // Arenas of threads that have exited, freed at the next endFrame since allocations made from
+    // them earlier in the frame may still be in use
+    std::vector<std::unique_ptr<FrameArena>> retired;
+    size_t blockSize;
+
+    // Hands the thread's arena back when the thread exits
+    struct Registration {
+        FrameAllocator* owner = nullptr;
+        FrameArena* arena = nullptr;
+
+        ~Registration() {
+            if (owner) owner->retire(arena);
+        }
+    };
+
+    FrameAllocator(size_t blockSize) : blockSize(blockSize) {}
+
+  public:
+    static FrameAllocator& instance() {
+        static FrameAllocator allocator(1 << 20);
+        return allocator;
+    }
+
+    // The calling thread's arena, created on first use
+    FrameArena& local() {
+        thread_local Registration registration;
+        if (!registration.arena) {
+            std::lock_guard lock(mutex);
+            arenas.push_back(std::make_unique<FrameArena>(blockSize, &counter));
+            registration.owner = this;
+            registration.arena = arenas.back().get();
+        }
+        return *registration.arena;
+    }
+
+    // Must only be called while no other thread is allocating from its arena
+    void endFrame() {
+        std::lock_guard lock(mutex);
+        for (auto& arena : arenas) arena->reset();
+        retired.clear();
+    }
+
+    // Blocks the arenas have taken from upstream so far, unchanged across a steady state frame
+    size_t arenaGrowths() const { return counter.allocationCount(); }
+
+    size_t arenaCount() {
+        std::lock_guard lock(mutex);
+        return arenas.size();
+    }
+
+    size_t reserved() {
+        std::lock_guard lock(mutex);
+        size_t total = 0;
+        for (auto& arena : arenas) total += arena->reserved();
+        return total;
+    }
+
+  private:
+    void retire(FrameArena* arena) {
+        std::lock_guard lock(mutex);
+        auto found = std::find_if(
+            arenas.begin(), arenas.end(), [&](auto& owned) { return owned.get() == arena; });
+        if (found == arenas.end()) return;
+
+        retired.push_back(std::move(*found));
+        arenas.erase(found);
+    }
+};
+
+namespace Frame {
+
+// The calling thread's frame arena as a polymorphic resource for std::pmr containers
+inline std::pmr::memory_resource* resource() { return &FrameAllocator::instance().local(); }
+
+} // namespace Frame
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "ImageEncoder.h"
+#include "ThreadPool.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Captures the default framebuffer without stalling the renderer. Each captured frame is read
+// into one of a ring of pixel pack buffers, the copy is collected a few frames later once its fence
+// has signalled, and the pixels are encoded to disk on a pool of its own, so slow encodes never
+// hold up parallelFor work on the shared pool. When every buffer is still in flight or too many
+// encodes are queued the frame is skipped and counted, rather than waiting.
+class FrameCapture {
+  public:
+    static constexpr unsigned RingSize = 3;
+
+  private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        std::string path;
+    };
+
+    int width;
+    int height;
+    ImageEncoder::Format format;
+    ThreadPool& pool;
+    unsigned maxPendingEncodes;
+
+    std::array<Slot, RingSize> slots;
+    unsigned head = 0;
+    unsigned tail = 0;
+
+    std::string prefix;
+    bool recording = false;
+    uint64_t frame = 0;
+
+    std::vector<std::future<bool>> encodes;
+    std::atomic<size_t> failed = 0;
+    size_t captured = 0;
+    size_t dropped = 0;
+
+  public:
+    FrameCapture(int width, int height, ImageEncoder::Format format = ImageEncoder::Format::Png,
+        ThreadPool& pool = encoderPool(), unsigned maxPendingEncodes = 8)
+        : width(width), height(height), format(format), pool(pool),
+          maxPendingEncodes(maxPendingEncodes) {
+        for (auto& slot : slots) {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, byteSize(), nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    ~FrameCapture() {
+        stop();
+        for (auto& slot : slots) {
+            if (slot.fence) glDeleteSync(slot.fence);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Two encoder threads, shared by every capture and kept apart from ThreadPool::instance()
+    static ThreadPool& encoderPool() {
+        static ThreadPool pool(2);
+        return pool;
+    }
+
+    size_t byteSize() const { return static_cast<size_t>(width) * height * 4; }
+
+    // Starts writing every frame to the prefix followed by a five digit frame number, so
+    // "capture/frame" gives capture/frame00000.png, capture/frame00001.png and so on
+    void start(const std::string& filePrefix) {
+        prefix = filePrefix;
+        recording = true;
+        frame = 0;
+    }
+
+    // Captures only the current frame
+    void screenshot(const std::string& path) { request(path + ImageEncoder::extension(format)); }
+
+    // Flushes every frame still in flight and waits for its encoding. A readback that has not
+    // completed within a second is abandoned and counted as failed.
+    void stop() {
+        recording = false;
+        for (unsigned i = 0; i < RingSize; i++) collect(true);
+        for (auto& encode : encodes) {
+            if (!encode.get()) failed++;
+        }
+        encodes.clear();
+    }
+
+    // Call once per frame after rendering and before swapping buffers
+    void update() {
+        collect(false);
+        if (recording) {
+            char number[24];
+            std::snprintf(number, sizeof(number), "%05llu", static_cast<unsigned long long>(frame));
+            request(prefix + number + ImageEncoder::extension(format));
+        }
+        frame++;
+    }
+
+    bool isRecording() const { return recording; }
+
+    size_t framesCaptured() const { return captured; }
+
+    size_t framesDropped() const { return dropped; }
+
+    size_t framesFailed() const { return failed; }
+
+  private:
+    void request(const std::string& path) {
+        retireEncodes();
+
+        auto& slot = slots[head];
+        if (slot.fence || encodes.size() >= maxPendingEncodes) {
+            dropped++;
+            return;
+        }
+
+        GLint alignment;
+        glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.path = path;
+        head = (head + 1) % RingSize;
+    }
+
+    // Hands the oldest finished readback to an encoder. Only blocks when flushing, where a fence
+    // that times out or fails is released along with its frame rather than left in the ring.
+    void collect(bool wait) {
+        auto& slot = slots[tail];
+        if (!slot.fence) return;
+
+        GLuint64 timeout = wait ? 1000000000ull : 0;
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status == GL_TIMEOUT_EXPIRED && !wait) return;
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        tail = (tail + 1) % RingSize;
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            failed++;
+            return;
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        auto mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, byteSize(), GL_MAP_READ_BIT);
+        if (!mapped) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            failed++;
+            return;
+        }
+
+        auto pixels = std::make_shared<std::vector<uint8_t>>(byteSize());
+        std::memcpy(pixels->data(), mapped, byteSize());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        captured++;
+
+        encodes.push_back(pool.submit([path = slot.path, pixels, format = format,
+                                          width = width, height = height] {
+            return ImageEncoder::write(path, format, width, height, pixels->data());
+        }));
+    }
+
+    void retireEncodes() {
+        for (size_t i = 0; i < encodes.size();) {
+            if (encodes[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                i++;
+                continue;
+            }
+            if (!encodes[i].get()) failed++;
+            encodes[i] = std::move(encodes.back());
+            encodes.pop_back();
+        }
+    }
+};
@@ -6,6 +6,7 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <string>
 #include <vector>
 #include <cmath>
@@ -15,6 +16,12 @@
 
 using Attribute = unsigned int;
 
+// How an index list forms triangles. VertexArray draws strips, cpu-side consumers take either.
+enum class Primitive {
+    Triangles,
+    TriangleStrip,
+};
+
 // Wraps an OpenGL Vertex Buffer
 struct VertexBuffer {
     unsigned target = GL_ARRAY_BUFFER;
@@ -64,6 +71,15 @@ struct VertexArray {
         glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
         unbind();
     }
+
+    // Draws without touching uniforms, for programs fed entirely through uniform buffers
+    void draw(ShaderProgram& program, DeviceTexture& texture) {
+        program.use();
+        bind();
+        texture.bind();
+        glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+        unbind();
+    }
 };
 
 // Constructs a Vertex Array from a list of vertices and a list of uvs
@@ -76,8 +92,14 @@ struct VertexArrayBuilder {
     };
     
     Component current;
-    std::vector<float> data;
-    std::vector<uint32_t> indices;
+    // Polymorphic allocator vectors so a builder can live in a frame arena. They do not convert
+    // to or from std::vector, copy with assign or the iterator constructors instead.
+    std::pmr::vector<float> data;
+    std::pmr::vector<uint32_t> indices;
+
+    // Transient builders can pass Frame::resource() to keep their storage in the frame arena
+    VertexArrayBuilder(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : data(resource), indices(resource) {}
 
     VertexArrayBuilder& vertex(float x, float y, float z, float w) {
         current.x = x;
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <png.h>
+
+// Writes RGBA8 pixel data to disk. Rows are given bottom up, as glReadPixels and Framebuffer
+// store them, and written top down as image formats expect.
+namespace ImageEncoder {
+
+enum class Format {
+    Png,
+    Qoi,
+    Raw,
+};
+
+inline const char* extension(Format format) {
+    switch (format) {
+    case Format::Png: return ".png";
+    case Format::Qoi: return ".qoi";
+    case Format::Raw: return ".rgba";
+    }
+    return "";
+}
+
+// Fast compression suits capture, where encode time matters more than file size
+inline bool writePng(const std::string& path, int width, int height, const uint8_t* pixels,
+    int compression = 1) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "Failed to open image for writing: " << path << std::endl;
+        return false;
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!png || !info || setjmp(png_jmpbuf(png))) {
+        std::cout << "Failed to encode png: " << path << std::endl;
+        png_destroy_write_struct(&png, &info);
+        std::fclose(file);
+        return false;
+    }
+
+    png_init_io(png, file);
+    png_set_compression_level(png, compression);
+    png_set_filter(png, 0, PNG_FILTER_SUB);
+    png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE,
+        PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+
+    for (int y = height - 1; y >= 0; y--) {
+        png_write_row(png, const_cast<uint8_t*>(pixels + static_cast<size_t>(y) * width * 4));
+    }
+
+    png_write_end(png, nullptr);
+    png_destroy_write_struct(&png, &info);
+    std::fclose(file);
+    return true;
+}
+
+// The Quite OK Image format, several times faster to encode than png at a similar size
+inline std::vector<uint8_t> encodeQoi(int width, int height, const uint8_t* pixels) {
+    std::vector<uint8_t> out;
+    out.reserve(14 + static_cast<size_t>(width) * height * 2 + 8);
+
+    auto put32 = [&](uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back(value >> shift);
+    };
+    out.insert(out.end(), {'q', 'o', 'i', 'f'});
+    put32(width);
+    put32(height);
+    out.push_back(4);
+    out.push_back(0);
+
+    uint8_t index[64][4] = {};
+    uint8_t previous[4] = {0, 0, 0, 255};
+    int run = 0;
+
+    for (int y = height - 1; y >= 0; y--) {
+        const uint8_t* row = pixels + static_cast<size_t>(y) * width * 4;
+        for (int x = 0; x < width; x++) {
+            const uint8_t* px = row + x * 4;
+
+            if (std::memcmp(px, previous, 4) == 0) {
+                if (++run == 62) {
+                    out.push_back(0xc0 | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0) {
+                out.push_back(0xc0 | (run - 1));
+                run = 0;
+            }
+
+            int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+            if (std::memcmp(index[hash], px, 4) == 0) {
+                out.push_back(hash);
+            } else {
+                std::memcpy(index[hash], px, 4);
+
+                if (px[3] == previous[3]) {
+                    int8_t dr = px[0] - previous[0];
+                    int8_t dg = px[1] - previous[1];
+                    int8_t db = px[2] - previous[2];
+                    int8_t drg = dr - dg;
+                    int8_t dbg = db - dg;
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        out.push_back(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 &&
+                               dbg <= 7) {
+                        out.push_back(0x80 | (dg + 32));
+                        out.push_back((drg + 8) << 4 | (dbg + 8));
+                    } else {
+                        out.insert(out.end(), {0xfe, px[0], px[1], px[2]});
+                    }
+                } else {
+                    out.insert(out.end(), {0xff, px[0], px[1], px[2], px[3]});
+                }
+            }
+
+            std::memcpy(previous, px, 4);
+        }
+    }
+
+    if (run > 0) out.push_back(0xc0 | (run - 1));
+    out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+    return out;
+}
+
+inline bool writeBytes(const std::string& path, const uint8_t* data, size_t size) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "Failed to open image for writing: " << path << std::endl;
+        return false;
+    }
+    bool written = std::fwrite(data, 1, size, file) == size;
+    std::fclose(file);
+    return written;
+}
+
+inline bool write(
+    const std::string& path, Format format, int width, int height, const uint8_t* pixels) {
+    switch (format) {
+    case Format::Png: return writePng(path, width, height, pixels);
+    case Format::Qoi: {
+        auto encoded = encodeQoi(width, height, pixels);
+        return writeBytes(path, encoded.data(), encoded.size());
+    }
+    case Format::Raw: return writeBytes(path, pixels, static_cast<size_t>(width) * height * 4);
+    }
+    return false;
+}
+
+} // namespace ImageEncoder
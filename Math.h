@@ -263,4 +263,25 @@ struct Matrix4 {
         result.data[10] = z;
         return result;
     }
+
+    static Matrix4 rotateZ(float radians) {
+        Matrix4 result = identity();
+        float c = std::cos(radians);
+        float s = std::sin(radians);
+        result.data[0] = c;
+        result.data[1] = -s;
+        result.data[4] = s;
+        result.data[5] = c;
+        return result;
+    }
+
+    // Maps the box [left, right] x [bottom, top] x [-1, 1] onto normalized device coordinates
+    static Matrix4 orthographic(float left, float right, float bottom, float top) {
+        Matrix4 result = identity();
+        result.data[0] = 2.0f / (right - left);
+        result.data[3] = -(right + left) / (right - left);
+        result.data[5] = 2.0f / (top - bottom);
+        result.data[7] = -(top + bottom) / (top - bottom);
+        return result;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,509 @@
+#pragma once
+
+#include "Graphics.h"
+#include "Math.h"
+#include "Shader.h"
+#include "Texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Simplifies triangle lists by edge collapse, ordered by quadric error (Garland and Heckbert).
+// Collapses move a vertex onto one of its neighbours instead of a new position, so every level
+// indexes the original vertices and can share their buffer. Vertices on an attribute seam (several
+// vertices at one position) or on an open border are locked, which keeps uv and normal seams and
+// silhouettes of open meshes intact.
+namespace MeshSimplifier {
+
+using Component = VertexArrayBuilder::Component;
+
+// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+
+    static Quadric plane(double a, double b, double c, double d) {
+        Quadric q;
+        q.a00 = a * a, q.a01 = a * b, q.a02 = a * c, q.a03 = a * d;
+        q.a11 = b * b, q.a12 = b * c, q.a13 = b * d;
+        q.a22 = c * c, q.a23 = c * d;
+        q.a33 = d * d;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& o) {
+        a00 += o.a00, a01 += o.a01, a02 += o.a02, a03 += o.a03;
+        a11 += o.a11, a12 += o.a12, a13 += o.a13;
+        a22 += o.a22, a23 += o.a23;
+        a33 += o.a33;
+        return *this;
+    }
+
+    double evaluate(double x, double y, double z) const {
+        return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x + a11 * y * y +
+               2 * a12 * y * z + 2 * a13 * y + a22 * z * z + 2 * a23 * z + a33;
+    }
+};
+
+// A simplified index list and an upper estimate of its distance from the source surface
+struct Level {
+    std::vector<uint32_t> indices;
+    float error;
+};
+
+// Collapses edges until the triangle count reaches each target in turn, given in decreasing
+// order, and returns one level per target reached
+inline std::vector<Level> simplify(const Component* vertices, size_t vertexCount,
+    const uint32_t* indices, size_t indexCount, const std::vector<size_t>& targets) {
+    struct Candidate {
+        float cost;
+        uint32_t from;
+        uint32_t to;
+        uint32_t stamp;
+        bool operator>(const Candidate& other) const { return cost > other.cost; }
+    };
+
+    auto position = [&](uint32_t v) {
+        return Vector3(vertices[v].x, vertices[v].y, vertices[v].z);
+    };
+
+    // Vertices sharing a position are one point of the surface with different attributes
+    std::vector<uint32_t> group(vertexCount);
+    std::vector<uint32_t> groupSize(vertexCount, 0);
+    {
+        struct Key {
+            uint32_t x, y, z;
+            bool operator==(const Key& o) const { return x == o.x && y == o.y && z == o.z; }
+        };
+        struct Hash {
+            size_t operator()(const Key& k) const {
+                return (k.x * 73856093u) ^ (k.y * 19349663u) ^ (k.z * 83492791u);
+            }
+        };
+        std::unordered_map<Key, uint32_t, Hash> canonical;
+        canonical.reserve(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            Key key;
+            std::memcpy(&key.x, &vertices[v].x, 4);
+            std::memcpy(&key.y, &vertices[v].y, 4);
+            std::memcpy(&key.z, &vertices[v].z, 4);
+            group[v] = canonical.try_emplace(key, v).first->second;
+            groupSize[group[v]]++;
+        }
+    }
+
+    // Drop triangles that are already degenerate in position
+    std::vector<uint32_t> triangles;
+    triangles.reserve(indexCount);
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (group[a] == group[b] || group[b] == group[c] || group[a] == group[c]) continue;
+        triangles.insert(triangles.end(), {a, b, c});
+    }
+    size_t triangleCount = triangles.size() / 3;
+    std::vector<uint8_t> triangleAlive(triangleCount, true);
+
+    std::vector<std::vector<uint32_t>> incident(vertexCount);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) incident[triangles[t * 3 + k]].push_back(t);
+    }
+
+    // Seam vertices, and both ends of border or non-manifold edges, never move
+    std::vector<uint8_t> locked(vertexCount, false);
+    {
+        std::unordered_map<uint64_t, uint32_t> edges;
+        edges.reserve(triangles.size());
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                uint64_t a = group[triangles[t * 3 + k]], b = group[triangles[t * 3 + (k + 1) % 3]];
+                edges[std::min(a, b) << 32 | std::max(a, b)]++;
+            }
+        }
+        std::vector<bool> lockedGroup(vertexCount, false);
+        for (auto& [edge, uses] : edges) {
+            if (uses == 2) continue;
+            lockedGroup[edge >> 32] = true;
+            lockedGroup[edge & 0xffffffff] = true;
+        }
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            locked[v] = groupSize[group[v]] > 1 || lockedGroup[group[v]];
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        Vector3 p0 = position(triangles[t * 3]), p1 = position(triangles[t * 3 + 1]);
+        Vector3 p2 = position(triangles[t * 3 + 2]);
+        Vector3 e1(p1.x - p0.x, p1.y - p0.y, p1.z - p0.z);
+        Vector3 e2(p2.x - p0.x, p2.y - p0.y, p2.z - p0.z);
+        double nx = e1.y * e2.z - e1.z * e2.y;
+        double ny = e1.z * e2.x - e1.x * e2.z;
+        double nz = e1.x * e2.y - e1.y * e2.x;
+        double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+        if (length == 0) continue;
+        nx /= length, ny /= length, nz /= length;
+        auto q = Quadric::plane(nx, ny, nz, -(nx * p0.x + ny * p0.y + nz * p0.z));
+        for (int k = 0; k < 3; k++) quadrics[group[triangles[t * 3 + k]]] += q;
+    }
+
+    // A vertex's entry in the queue is current while its stamp matches
+    std::vector<uint32_t> stamp(vertexCount, 0);
+    std::vector<Candidate> queued(vertexCount);
+    std::vector<uint8_t> removed(vertexCount, false);
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> queue;
+
+    // Queues the cheapest collapse of v onto one of its neighbours. The target does not move, so
+    // the error a collapse adds is v's quadric evaluated at the target.
+    auto consider = [&](uint32_t v) {
+        stamp[v]++;
+        if (locked[v] || removed[v]) return;
+
+        uint32_t previous = v;
+
+        Candidate best{std::numeric_limits<float>::infinity(), v, v, stamp[v]};
+        for (uint32_t t : incident[v]) {
+            if (!triangleAlive[t]) continue;
+            for (int k = 0; k < 3; k++) {
+                // Neighbours in a fan repeat from one triangle to the next
+                uint32_t to = triangles[t * 3 + k];
+                if (to == v || to == previous) continue;
+                previous = to;
+                Vector3 p = position(to);
+                float cost = quadrics[v].evaluate(p.x, p.y, p.z);
+                if (cost < best.cost) {
+                    best.cost = cost;
+                    best.to = to;
+                }
+            }
+        }
+        if (best.to == v) return;
+        queued[v] = best;
+        queue.push(best);
+    };
+
+    // After from collapsed into to, a neighbour lost from and may have gained to. Unless its queued
+    // collapse was onto from, the only new option to weigh is the collapse onto to.
+    auto reconsider = [&](uint32_t v, uint32_t from, uint32_t to) {
+        if (locked[v] || removed[v]) return;
+        if (queued[v].stamp != stamp[v] || queued[v].to == from) {
+            consider(v);
+            return;
+        }
+
+        Vector3 p = position(to);
+        float cost = quadrics[v].evaluate(p.x, p.y, p.z);
+        if (cost >= queued[v].cost) return;
+        queued[v] = {cost, v, to, ++stamp[v]};
+        queue.push(queued[v]);
+    };
+
+    auto normal = [](Vector3 a, Vector3 b, Vector3 c) {
+        Vector3 e1(b.x - a.x, b.y - a.y, b.z - a.z), e2(c.x - a.x, c.y - a.y, c.z - a.z);
+        return Vector3(
+            e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+    };
+
+    // Collapsing must not turn any surviving triangle over
+    auto flips = [&](uint32_t from, uint32_t to) {
+        Vector3 target = position(to);
+        for (uint32_t t : incident[from]) {
+            if (!triangleAlive[t]) continue;
+            Vector3 p[3];
+            bool collapses = false;
+            int moved = 0;
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = triangles[t * 3 + k];
+                collapses |= group[v] == group[to];
+                if (v == from) moved = k;
+                p[k] = position(v);
+            }
+            if (collapses) continue;
+
+            Vector3 before = normal(p[0], p[1], p[2]);
+            p[moved] = target;
+            Vector3 after = normal(p[0], p[1], p[2]);
+            double dot = before.x * after.x + before.y * after.y + before.z * after.z;
+            double lengths = std::sqrt(
+                (before.x * before.x + before.y * before.y + before.z * before.z) *
+                (after.x * after.x + after.y * after.y + after.z * after.z));
+            if (dot <= 0.25 * lengths) return true;
+        }
+        return false;
+    };
+
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (!incident[v].empty()) consider(v);
+    }
+
+    std::vector<Level> levels;
+    double maxCost = 0;
+    size_t alive = triangleCount;
+
+    auto snapshot = [&] {
+        Level level;
+        level.indices.reserve(alive * 3);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            if (!triangleAlive[t]) continue;
+            level.indices.insert(level.indices.end(), &triangles[t * 3], &triangles[t * 3 + 3]);
+        }
+        level.error = static_cast<float>(std::sqrt(maxCost));
+        levels.push_back(std::move(level));
+    };
+
+    std::vector<uint32_t> affected;
+    for (size_t target : targets) {
+        while (alive > target && !queue.empty()) {
+            Candidate candidate = queue.top();
+            queue.pop();
+            uint32_t from = candidate.from, to = candidate.to;
+            if (candidate.stamp != stamp[from] || removed[from] || removed[to]) continue;
+            stamp[from]++;
+
+            // Retried when a neighbouring collapse changes this vertex's surroundings
+            if (flips(from, to)) continue;
+
+            // The merged quadric at the target bounds the distance to every plane it has absorbed
+            quadrics[group[to]] += quadrics[from];
+            Vector3 p = position(to);
+            maxCost = std::max(maxCost, quadrics[group[to]].evaluate(p.x, p.y, p.z));
+            removed[from] = true;
+
+            // Only the vertices of the moved and removed triangles gain or lose neighbours
+            affected.clear();
+            for (uint32_t t : incident[from]) {
+                if (!triangleAlive[t]) continue;
+                uint32_t* corners = &triangles[t * 3];
+                affected.insert(affected.end(), corners, corners + 3);
+                if (group[corners[0]] == group[to] || group[corners[1]] == group[to] ||
+                    group[corners[2]] == group[to]) {
+                    triangleAlive[t] = false;
+                    alive--;
+                    continue;
+                }
+                for (int k = 0; k < 3; k++) {
+                    if (corners[k] == from) corners[k] = to;
+                }
+                incident[to].push_back(t);
+            }
+            incident[from].clear();
+
+            std::sort(affected.begin(), affected.end());
+            affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+            for (uint32_t v : affected) {
+                if (v != to) reconsider(v, from, to);
+            }
+            // The target's quadric grew, so every collapse out of it costs more
+            consider(to);
+
+            // Keep the target's incidence list from filling up with dead triangles
+            auto& list = incident[to];
+            if (list.size() > 32) {
+                list.erase(std::remove_if(list.begin(), list.end(),
+                               [&](uint32_t t) { return !triangleAlive[t]; }),
+                    list.end());
+            }
+        }
+
+        // Nothing left to collapse, further targets would repeat this level
+        snapshot();
+        if (alive > target) break;
+    }
+
+    return levels;
+}
+
+} // namespace MeshSimplifier
+
+// A range of the shared index buffer and the largest distance it strays from the full mesh
+struct LodLevel {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+};
+
+// Index lists for every level of a mesh, concatenated, level 0 being the original triangles
+struct LodChain {
+    std::vector<uint32_t> indices;
+    std::vector<LodLevel> levels;
+    Vector3 center;
+    float radius = 0;
+
+    struct Options {
+        // Triangle count of each level relative to the one before
+        float ratio = 0.5f;
+        int maxLevels = 8;
+        size_t minTriangles = 64;
+    };
+
+    // Every level is a triangle list, a strip is converted first
+    static LodChain build(const VertexArrayBuilder& builder, const Options& options,
+        Primitive primitive = Primitive::TriangleStrip) {
+        using Component = VertexArrayBuilder::Component;
+        auto vertices = reinterpret_cast<const Component*>(builder.data.data());
+        size_t vertexCount = builder.data.size() / (sizeof(Component) / sizeof(float));
+
+        LodChain chain;
+        chain.bound(vertices, vertexCount);
+        chain.indices =
+            triangleList(builder.indices.data(), builder.indices.size(), primitive);
+        chain.levels.push_back({0, static_cast<uint32_t>(chain.indices.size()), 0.0f});
+
+        std::vector<size_t> targets;
+        size_t triangles = chain.indices.size() / 3;
+        for (int level = 1; level < options.maxLevels; level++) {
+            triangles = static_cast<size_t>(triangles * options.ratio);
+            if (triangles < options.minTriangles) break;
+            targets.push_back(triangles);
+        }
+
+        auto simplified = MeshSimplifier::simplify(
+            vertices, vertexCount, chain.indices.data(), chain.indices.size(), targets);
+        for (auto& level : simplified) {
+            // A level that barely shrank costs memory without saving any work, and one that strays
+            // further than the bounds' radius only ever suits a mesh smaller than a pixel
+            if (level.indices.size() > chain.levels.back().indexCount * 9 / 10) break;
+            if (level.error > chain.radius) break;
+
+            chain.levels.push_back({static_cast<uint32_t>(chain.indices.size()),
+                static_cast<uint32_t>(level.indices.size()), level.error});
+            chain.indices.insert(chain.indices.end(), level.indices.begin(), level.indices.end());
+        }
+
+        return chain;
+    }
+
+    static LodChain build(
+        const VertexArrayBuilder& builder, Primitive primitive = Primitive::TriangleStrip) {
+        return build(builder, Options(), primitive);
+    }
+
+    // Unrolls a strip into a list, flipping every other triangle to keep the winding and dropping
+    // the degenerate ones strips use to join runs
+    static std::vector<uint32_t> triangleList(
+        const uint32_t* indices, size_t count, Primitive primitive) {
+        if (primitive == Primitive::Triangles) return {indices, indices + count};
+
+        std::vector<uint32_t> list;
+        list.reserve(count > 2 ? (count - 2) * 3 : 0);
+        for (size_t i = 0; i + 2 < count; i++) {
+            uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            if (a == b || b == c || a == c) continue;
+            if (i % 2 == 0) {
+                list.insert(list.end(), {a, b, c});
+            } else {
+                list.insert(list.end(), {b, a, c});
+            }
+        }
+        return list;
+    }
+
+    // The coarsest level whose error stays under threshold pixels, given how many pixels one unit
+    // of the mesh covers on screen
+    size_t select(float pixelsPerUnit, float threshold = 1.0f) const {
+        size_t level = 0;
+        while (level + 1 < levels.size() && levels[level + 1].error * pixelsPerUnit <= threshold) {
+            level++;
+        }
+        return level;
+    }
+
+    // Pixels per mesh unit at the centre of the bounds under a clip space transform. The w divide
+    // makes this shrink with distance under a perspective projection.
+    float pixelsPerUnit(const Matrix4& transform, int viewportWidth, int viewportHeight) const {
+        auto& m = transform.data;
+        float sx = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]) * viewportWidth * 0.5f;
+        float sy = std::sqrt(m[4] * m[4] + m[5] * m[5] + m[6] * m[6]) * viewportHeight * 0.5f;
+        float w = m[12] * center.x + m[13] * center.y + m[14] * center.z + m[15];
+        return std::max(sx, sy) / std::max(w, 1e-6f);
+    }
+
+  private:
+    void bound(const VertexArrayBuilder::Component* vertices, size_t count) {
+        if (count == 0) return;
+        Vector3 low(vertices[0].x, vertices[0].y, vertices[0].z), high = low;
+        for (size_t i = 1; i < count; i++) {
+            low = Vector3(std::min(low.x, vertices[i].x), std::min(low.y, vertices[i].y),
+                std::min(low.z, vertices[i].z));
+            high = Vector3(std::max(high.x, vertices[i].x), std::max(high.y, vertices[i].y),
+                std::max(high.z, vertices[i].z));
+        }
+        center = Vector3((low.x + high.x) / 2, (low.y + high.y) / 2, (low.z + high.z) / 2);
+        float dx = high.x - center.x, dy = high.y - center.y, dz = high.z - center.z;
+        radius = std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+};
+
+// A mesh and all its levels in one vertex buffer and one index buffer, drawn as triangle lists
+struct LodMesh {
+    VertexArray vao;
+    LodChain chain;
+
+    LodMesh(const VertexArrayBuilder& builder, LodChain lods, Attribute vertex, Attribute uv,
+        Attribute normal)
+        : chain(std::move(lods)) {
+        using Component = VertexArrayBuilder::Component;
+        auto vbo = std::make_unique<VertexBuffer>();
+        auto ebo = std::make_unique<VertexBuffer>();
+        ebo->target = GL_ELEMENT_ARRAY_BUFFER;
+
+        glBindVertexArray(vao.id);
+        vbo->bind();
+        ebo->bind();
+
+        glBufferData(GL_ARRAY_BUFFER, builder.data.size() * sizeof(float), builder.data.data(),
+            GL_STATIC_DRAW);
+        glVertexAttribPointer(
+            vertex, 4, GL_FLOAT, GL_FALSE, sizeof(Component), (void*)offsetof(Component, x));
+        glEnableVertexAttribArray(vertex);
+        glVertexAttribPointer(
+            uv, 2, GL_FLOAT, GL_FALSE, sizeof(Component), (void*)offsetof(Component, u));
+        glEnableVertexAttribArray(uv);
+        glVertexAttribPointer(
+            normal, 3, GL_FLOAT, GL_FALSE, sizeof(Component), (void*)offsetof(Component, nx));
+        glEnableVertexAttribArray(normal);
+
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, chain.indices.size() * sizeof(uint32_t),
+            chain.indices.data(), GL_STATIC_DRAW);
+        vao.indexCount = chain.levels[0].indexCount;
+
+        glBindVertexArray(0);
+        vbo->unbind();
+        ebo->unbind();
+
+        vao.addBuffer(std::move(vbo));
+        vao.addBuffer(std::move(ebo));
+    }
+
+    // Draws the level selected for the transform's projected scale, returning its index
+    size_t draw(ShaderProgram& program, const Matrix4& transform, DeviceTexture& texture,
+        int viewportWidth, int viewportHeight, float threshold = 1.0f) {
+        size_t level =
+            chain.select(chain.pixelsPerUnit(transform, viewportWidth, viewportHeight), threshold);
+        draw(program, transform, texture, level);
+        return level;
+    }
+
+    void draw(ShaderProgram& program, const Matrix4& transform, DeviceTexture& texture,
+        size_t level) {
+        auto& range = chain.levels[std::min(level, chain.levels.size() - 1)];
+        program.use();
+        glBindVertexArray(vao.id);
+        program.setUniform("uTransform", transform);
+        texture.bind();
+        glDrawElements(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+            (void*)(range.firstIndex * sizeof(uint32_t)));
+        glBindVertexArray(0);
+    }
+};
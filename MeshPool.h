@@ -0,0 +1,446 @@
+#pragma once
+
+#include "Graphics.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Suballocates element ranges out of a fixed capacity. Free ranges are kept sorted by offset and
+// coalesced on release, allocation is first-fit. Holds no GL state so it can be exercised on the cpu.
+struct RangeAllocator {
+    struct Range {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // A live range that has to be copied from one offset to another during compaction
+    struct Relocation {
+        uint32_t from;
+        uint32_t to;
+        uint32_t size;
+    };
+
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+    std::vector<Range> freeList;
+    std::map<uint32_t, uint32_t> allocations;
+
+    RangeAllocator() = default;
+
+    RangeAllocator(uint32_t capacity) : capacity(capacity) {
+        if (capacity > 0) freeList.push_back({0, capacity});
+    }
+
+    std::optional<uint32_t> allocate(uint32_t size) {
+        if (size == 0) return std::nullopt;
+
+        for (auto it = freeList.begin(); it != freeList.end(); ++it) {
+            if (it->size < size) continue;
+
+            uint32_t offset = it->offset;
+            it->offset += size;
+            it->size -= size;
+            if (it->size == 0) freeList.erase(it);
+
+            allocations[offset] = size;
+            used += size;
+            return offset;
+        }
+
+        return std::nullopt;
+    }
+
+    void release(uint32_t offset) {
+        auto found = allocations.find(offset);
+        if (found == allocations.end()) return;
+
+        uint32_t size = found->second;
+        allocations.erase(found);
+        used -= size;
+
+        // Insert in offset order, then merge with the neighbours on either side
+        auto it = freeList.begin();
+        while (it != freeList.end() && it->offset < offset) ++it;
+        it = freeList.insert(it, {offset, size});
+
+        auto next = it + 1;
+        if (next != freeList.end() && it->offset + it->size == next->offset) {
+            it->size += next->size;
+            freeList.erase(next);
+        }
+
+        if (it != freeList.begin()) {
+            auto previous = it - 1;
+            if (previous->offset + previous->size == it->offset) {
+                previous->size += it->size;
+                freeList.erase(it);
+            }
+        }
+    }
+
+    // Grows the capacity, the new space is appended to the tail of the free list
+    void grow(uint32_t newCapacity) {
+        if (newCapacity <= capacity) return;
+
+        uint32_t extra = newCapacity - capacity;
+        if (!freeList.empty() && freeList.back().offset + freeList.back().size == capacity) {
+            freeList.back().size += extra;
+        } else {
+            freeList.push_back({capacity, extra});
+        }
+        capacity = newCapacity;
+    }
+
+    // Size of the free range running up to the end of the capacity, the part growth extends
+    uint32_t tailFree() const {
+        if (freeList.empty()) return 0;
+        auto& last = freeList.back();
+        return last.offset + last.size == capacity ? last.size : 0;
+    }
+
+    // The smallest doubling of the capacity after which allocate(size) is certain to succeed.
+    // Only the free tail grows, holes elsewhere do not help however much space they add up to.
+    // Saturates at the largest 32 bit capacity, which may still be too small for a huge request.
+    uint32_t grownCapacity(uint32_t size) const {
+        uint64_t grown = capacity > 0 ? capacity : 1;
+        while (tailFree() + (grown - capacity) < size && grown < UINT32_MAX) grown *= 2;
+        return static_cast<uint32_t>(std::min<uint64_t>(grown, UINT32_MAX));
+    }
+
+    uint32_t largestFree() const {
+        uint32_t largest = 0;
+        for (auto& range : freeList) {
+            if (range.size > largest) largest = range.size;
+        }
+        return largest;
+    }
+
+    // 0 when all free space is contiguous, approaching 1 as it splinters into small holes
+    float fragmentation() const {
+        uint32_t free = capacity - used;
+        if (free == 0) return 0.0f;
+        return 1.0f - static_cast<float>(largestFree()) / static_cast<float>(free);
+    }
+
+    // Slides every live range down to the start of the capacity. The returned relocations are in
+    // ascending offset order and describe the copies the owner of the memory has to perform.
+    std::vector<Relocation> defragment() {
+        std::vector<Relocation> relocations;
+        std::map<uint32_t, uint32_t> compacted;
+
+        uint32_t cursor = 0;
+        for (auto& [offset, size] : allocations) {
+            if (offset != cursor) relocations.push_back({offset, cursor, size});
+            compacted[cursor] = size;
+            cursor += size;
+        }
+
+        allocations = std::move(compacted);
+        freeList.clear();
+        if (cursor < capacity) freeList.push_back({cursor, capacity - cursor});
+
+        return relocations;
+    }
+};
+
+// Matches the layout glMultiDrawElementsIndirect reads from the indirect buffer
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+// A slot in the pool plus the generation it was handed out at. Removing a mesh bumps its slot's
+// generation, so a stale handle is ignored instead of reaching whichever mesh reuses the slot.
+struct MeshHandle {
+    uint32_t id;
+    uint32_t generation;
+};
+
+// Stores many meshes of the VertexArrayBuilder layout in one shared vertex buffer, one shared
+// index buffer and a single vertex array. Meshes index relative to their own first vertex, so they
+// are drawn with a base vertex rather than rewriting their indices.
+struct MeshPool {
+    using Component = VertexArrayBuilder::Component;
+
+    struct Mesh {
+        uint32_t baseVertex;
+        uint32_t vertexCount;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t generation;
+        bool live;
+    };
+
+    GLuint vao;
+    std::unique_ptr<VertexBuffer> vbo;
+    std::unique_ptr<VertexBuffer> ebo;
+    VertexBuffer indirect;
+
+    Attribute vertexAttribute, uvAttribute, normalAttribute;
+
+    RangeAllocator vertices;
+    RangeAllocator indices;
+
+    std::vector<Mesh> meshes;
+    std::vector<uint32_t> freeIds;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    MeshPool(Attribute vertex, Attribute uv, Attribute normal, uint32_t vertexCapacity = 1 << 16,
+        uint32_t indexCapacity = 1 << 18)
+        : vertexAttribute(vertex), uvAttribute(uv), normalAttribute(normal) {
+        glGenVertexArrays(1, &vao);
+        indirect.target = GL_DRAW_INDIRECT_BUFFER;
+        resize(vertexCapacity, indexCapacity, false);
+    }
+
+    ~MeshPool() { glDeleteVertexArrays(1, &vao); }
+
+    MeshPool(const MeshPool&) = delete;
+    MeshPool& operator=(const MeshPool&) = delete;
+
+    // Empty meshes are refused, they could never be drawn
+    std::optional<MeshHandle> add(const VertexArrayBuilder& builder) {
+        uint32_t vertexCount = builder.data.size() * sizeof(float) / sizeof(Component);
+        uint32_t indexCount = builder.indices.size();
+        if (vertexCount == 0 || indexCount == 0) return std::nullopt;
+
+        auto baseVertex = allocateOrGrow(vertices, vertexCount, true);
+        if (!baseVertex) return std::nullopt;
+
+        auto firstIndex = allocateOrGrow(indices, indexCount, false);
+        if (!firstIndex) {
+            vertices.release(*baseVertex);
+            return std::nullopt;
+        }
+
+        vbo->bind();
+        glBufferSubData(GL_ARRAY_BUFFER, *baseVertex * sizeof(Component),
+            vertexCount * sizeof(Component), builder.data.data());
+        vbo->unbind();
+
+        // The element binding is vertex array state, so the vao has to be bound to upload indices
+        glBindVertexArray(vao);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, *firstIndex * sizeof(uint32_t),
+            indexCount * sizeof(uint32_t), builder.indices.data());
+        glBindVertexArray(0);
+
+        Mesh mesh = {*baseVertex, vertexCount, *firstIndex, indexCount, 0, true};
+        if (!freeIds.empty()) {
+            uint32_t id = freeIds.back();
+            freeIds.pop_back();
+            mesh.generation = meshes[id].generation;
+            meshes[id] = mesh;
+            return MeshHandle{id, mesh.generation};
+        }
+
+        meshes.push_back(mesh);
+        return MeshHandle{static_cast<uint32_t>(meshes.size() - 1), 0};
+    }
+
+    // False for handles whose mesh was removed, even if the slot has been reused since
+    bool contains(MeshHandle handle) const {
+        return handle.id < meshes.size() && meshes[handle.id].live &&
+               meshes[handle.id].generation == handle.generation;
+    }
+
+    void remove(MeshHandle handle) {
+        if (!contains(handle)) return;
+
+        auto& mesh = meshes[handle.id];
+        vertices.release(mesh.baseVertex);
+        indices.release(mesh.firstIndex);
+        mesh.live = false;
+        mesh.generation++;
+        freeIds.push_back(handle.id);
+    }
+
+    // Compacts both buffers into fresh storage and patches every live mesh to its new ranges
+    void defragment() {
+        std::vector<RangeAllocator::Range> oldVertices = snapshot(vertices);
+        std::vector<RangeAllocator::Range> oldIndices = snapshot(indices);
+
+        auto vertexMoves = vertices.defragment();
+        auto indexMoves = indices.defragment();
+        if (vertexMoves.empty() && indexMoves.empty()) return;
+
+        auto oldVbo = std::move(vbo);
+        auto oldEbo = std::move(ebo);
+        allocateStorage(vertices.capacity, indices.capacity);
+
+        copyLive(*oldVbo, *vbo, oldVertices, vertices, sizeof(Component));
+        copyLive(*oldEbo, *ebo, oldIndices, indices, sizeof(uint32_t));
+
+        for (auto& mesh : meshes) {
+            if (!mesh.live) continue;
+            mesh.baseVertex = relocate(vertexMoves, mesh.baseVertex);
+            mesh.firstIndex = relocate(indexMoves, mesh.firstIndex);
+        }
+    }
+
+    // Queues a mesh for the next flush, the draw's index in the batch is passed as its base
+    // instance so a shader can fetch per draw data through an instanced attribute. Base instances
+    // need GL 4.2, below that every draw sees instance data from index 0.
+    void submit(MeshHandle handle) {
+        if (!contains(handle)) return;
+
+        auto& mesh = meshes[handle.id];
+
+        uint32_t drawId = commands.size();
+        commands.push_back({mesh.indexCount, 1, mesh.firstIndex,
+            static_cast<int32_t>(mesh.baseVertex), drawId});
+    }
+
+    // Issues every queued mesh, in one call when indirect multi draw is available
+    void flush(ShaderProgram& program, GLenum mode = GL_TRIANGLE_STRIP) {
+        if (commands.empty()) return;
+
+        program.use();
+        glBindVertexArray(vao);
+
+        if (GLAD_GL_VERSION_4_3) {
+            indirect.bind();
+            glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(),
+                GL_STREAM_DRAW);
+            glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr, commands.size(), 0);
+            indirect.unbind();
+        } else if (GLAD_GL_VERSION_4_2) {
+            for (auto& command : commands) {
+                auto offset = reinterpret_cast<void*>(command.firstIndex * sizeof(uint32_t));
+                glDrawElementsInstancedBaseVertexBaseInstance(mode, command.count, GL_UNSIGNED_INT,
+                    offset, 1, command.baseVertex, command.baseInstance);
+            }
+        } else {
+            for (auto& command : commands) {
+                auto offset = reinterpret_cast<void*>(command.firstIndex * sizeof(uint32_t));
+                glDrawElementsBaseVertex(
+                    mode, command.count, GL_UNSIGNED_INT, offset, command.baseVertex);
+            }
+        }
+
+        glBindVertexArray(0);
+        commands.clear();
+    }
+
+  private:
+    std::optional<uint32_t> allocateOrGrow(RangeAllocator& allocator, uint32_t size, bool isVertex) {
+        if (size == 0) return std::nullopt;
+        if (auto offset = allocator.allocate(size)) return offset;
+
+        // Growing is pointless when even the largest capacity leaves no room
+        uint32_t capacity = allocator.grownCapacity(size);
+        if (allocator.tailFree() + (capacity - allocator.capacity) < size) return std::nullopt;
+
+        if (isVertex) {
+            resize(capacity, indices.capacity, true);
+        } else {
+            resize(vertices.capacity, capacity, true);
+        }
+
+        return allocator.allocate(size);
+    }
+
+    // Reallocates storage at the given capacities, keeping the contents at the same offsets
+    void resize(uint32_t vertexCapacity, uint32_t indexCapacity, bool preserve) {
+        uint32_t oldVertexCapacity = vertices.capacity;
+        uint32_t oldIndexCapacity = indices.capacity;
+
+        auto oldVbo = std::move(vbo);
+        auto oldEbo = std::move(ebo);
+        allocateStorage(vertexCapacity, indexCapacity);
+
+        if (preserve && oldVbo && oldEbo) {
+            copyRange(*oldVbo, *vbo, 0, 0, oldVertexCapacity * sizeof(Component));
+            copyRange(*oldEbo, *ebo, 0, 0, oldIndexCapacity * sizeof(uint32_t));
+        }
+
+        if (vertices.capacity == 0) {
+            vertices = RangeAllocator(vertexCapacity);
+        } else {
+            vertices.grow(vertexCapacity);
+        }
+
+        if (indices.capacity == 0) {
+            indices = RangeAllocator(indexCapacity);
+        } else {
+            indices.grow(indexCapacity);
+        }
+    }
+
+    void allocateStorage(uint32_t vertexCapacity, uint32_t indexCapacity) {
+        vbo = std::make_unique<VertexBuffer>();
+        ebo = std::make_unique<VertexBuffer>();
+        ebo->target = GL_ELEMENT_ARRAY_BUFFER;
+
+        glBindVertexArray(vao);
+        vbo->bind();
+        ebo->bind();
+
+        glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(Component), nullptr, GL_STATIC_DRAW);
+        glBufferData(
+            GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+
+        glVertexAttribPointer(vertexAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(Component),
+            (void*)offsetof(Component, x));
+        glEnableVertexAttribArray(vertexAttribute);
+
+        glVertexAttribPointer(uvAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(Component),
+            (void*)offsetof(Component, u));
+        glEnableVertexAttribArray(uvAttribute);
+
+        glVertexAttribPointer(normalAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(Component),
+            (void*)offsetof(Component, nx));
+        glEnableVertexAttribArray(normalAttribute);
+
+        glBindVertexArray(0);
+        vbo->unbind();
+    }
+
+    static void copyRange(
+        VertexBuffer& source, VertexBuffer& destination, size_t from, size_t to, size_t bytes) {
+        if (bytes == 0) return;
+
+        glBindBuffer(GL_COPY_READ_BUFFER, source.id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, destination.id);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from, to, bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    static std::vector<RangeAllocator::Range> snapshot(const RangeAllocator& allocator) {
+        std::vector<RangeAllocator::Range> ranges;
+        ranges.reserve(allocator.allocations.size());
+        for (auto& [offset, size] : allocator.allocations) ranges.push_back({offset, size});
+        return ranges;
+    }
+
+    // Compaction preserves the order of the live ranges, so the pre compaction snapshot and the
+    // compacted allocations pair up one to one
+    static void copyLive(VertexBuffer& source, VertexBuffer& destination,
+        const std::vector<RangeAllocator::Range>& before, const RangeAllocator& after,
+        size_t stride) {
+        auto range = before.begin();
+        for (auto& [offset, size] : after.allocations) {
+            copyRange(source, destination, range->offset * stride, offset * stride, size * stride);
+            ++range;
+        }
+    }
+
+    // Relocations are sorted by their source offset
+    static uint32_t relocate(const std::vector<RangeAllocator::Relocation>& moves, uint32_t offset) {
+        auto found = std::lower_bound(moves.begin(), moves.end(), offset,
+            [](const RangeAllocator::Relocation& move, uint32_t value) { return move.from < value; });
+        if (found != moves.end() && found->from == offset) return found->to;
+        return offset;
+    }
+};
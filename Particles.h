@@ -0,0 +1,448 @@
+#pragma once
+
+#include "Math.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// How an emitter spawns its particles. Spreads are half widths of uniform random ranges.
+struct ParticleSettings {
+    Vector3 position;
+    Vector3 positionSpread;
+    Vector3 velocity;
+    Vector3 velocitySpread;
+    Vector3 acceleration;
+    // Fraction of velocity lost per second
+    float drag = 0.0f;
+    Vector4 startColor = Vector4(1, 1, 1, 1);
+    Vector4 endColor = Vector4(1, 1, 1, 0);
+    float lifetime = 1.0f;
+    float lifetimeSpread = 0.0f;
+    float size = 0.05f;
+    float sizeSpread = 0.0f;
+    // Particles spawned per second by update
+    float rate = 0.0f;
+};
+
+// Particle state as one array per attribute, so the update streams through memory and works on
+// four particles per instruction. Live particles are always packed at the front.
+class ParticleEmitter {
+  public:
+    enum Stream {
+        PositionX,
+        PositionY,
+        PositionZ,
+        VelocityX,
+        VelocityY,
+        VelocityZ,
+        ColorR,
+        ColorG,
+        ColorB,
+        ColorA,
+        Life,
+        Size,
+        StreamCount,
+    };
+
+    // Particles per unit of parallel work, each chunk integrates and compacts on its own
+    static constexpr size_t ChunkSize = 16384;
+
+    ParticleSettings settings;
+
+  private:
+    struct Free {
+        void operator()(float* block) const { std::free(block); }
+    };
+
+    size_t capacity;
+    size_t count = 0;
+    std::unique_ptr<float, Free> block;
+    std::array<float*, StreamCount> streams;
+    float pending = 0.0f;
+    uint32_t seed = 0x9e3779b9;
+    std::vector<size_t> live;
+
+  public:
+    ParticleEmitter(size_t capacity, const ParticleSettings& settings = {})
+        : settings(settings), capacity((capacity + 3) / 4 * 4) {
+        // One cache line aligned allocation, each stream a multiple of four floats long. The size
+        // is rounded up to whole cache lines as aligned_alloc requires. If the allocation fails
+        // the emitter is left without capacity and never spawns.
+        size_t bytes = (this->capacity * StreamCount * sizeof(float) + 63) / 64 * 64;
+        block.reset(static_cast<float*>(std::aligned_alloc(64, bytes)));
+        if (!block) {
+            std::cout << "Failed to allocate " << bytes << " bytes for particles" << std::endl;
+            this->capacity = 0;
+            streams.fill(nullptr);
+            return;
+        }
+        for (int s = 0; s < StreamCount; s++) streams[s] = block.get() + s * this->capacity;
+    }
+
+    ParticleEmitter(const ParticleEmitter&) = delete;
+    ParticleEmitter& operator=(const ParticleEmitter&) = delete;
+
+    size_t size() const { return count; }
+
+    size_t maxSize() const { return capacity; }
+
+    const float* stream(Stream s) const { return streams[s]; }
+
+    void clear() { count = 0; }
+
+    // Spawns up to count particles, fewer when the emitter is full. Returns how many were spawned.
+    size_t emit(size_t requested) {
+        size_t spawned = std::min(requested, capacity - count);
+        auto& s = settings;
+
+        for (size_t i = count; i < count + spawned; i++) {
+            streams[PositionX][i] = s.position.x + s.positionSpread.x * random();
+            streams[PositionY][i] = s.position.y + s.positionSpread.y * random();
+            streams[PositionZ][i] = s.position.z + s.positionSpread.z * random();
+            streams[VelocityX][i] = s.velocity.x + s.velocitySpread.x * random();
+            streams[VelocityY][i] = s.velocity.y + s.velocitySpread.y * random();
+            streams[VelocityZ][i] = s.velocity.z + s.velocitySpread.z * random();
+            streams[ColorR][i] = s.startColor.x;
+            streams[ColorG][i] = s.startColor.y;
+            streams[ColorB][i] = s.startColor.z;
+            streams[ColorA][i] = s.startColor.w;
+            streams[Life][i] = std::max(1e-3f, s.lifetime + s.lifetimeSpread * random());
+            streams[Size][i] = s.size + s.sizeSpread * random();
+        }
+
+        count += spawned;
+        return spawned;
+    }
+
+    // Spawns this step's share of the rate, then advances every particle by dt and removes the
+    // ones whose life ran out
+    void update(float dt, ThreadPool& pool = ThreadPool::instance()) {
+        pending += settings.rate * dt;
+        size_t spawn = static_cast<size_t>(pending);
+        pending -= spawn;
+        emit(spawn);
+
+        if (count == 0) return;
+
+        size_t chunks = (count + ChunkSize - 1) / ChunkSize;
+        live.resize(chunks);
+
+        pool.parallelFor(chunks, 1, [&](size_t first, size_t last) {
+            for (size_t chunk = first; chunk < last; chunk++) {
+                size_t begin = chunk * ChunkSize;
+                size_t end = std::min(count, begin + ChunkSize);
+                integrate(begin, end, dt);
+                live[chunk] = compactChunk(begin, end) - begin;
+            }
+        });
+
+        closeGaps(chunks);
+    }
+
+  private:
+    // Uniform in [-1, 1)
+    float random() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return static_cast<float>(seed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+    }
+
+    void integrate(size_t begin, size_t end, float dt) {
+        auto& s = settings;
+        float damping = std::max(0.0f, 1.0f - s.drag * dt);
+        // The colour moves at the rate that takes a particle of average lifetime to the end colour.
+        // Lifetimes are clamped like at emission, so a zero lifetime cannot divide by zero.
+        float rate = dt / std::max(1e-3f, s.lifetime);
+        float colorStep[4] = {
+            (s.endColor.x - s.startColor.x) * rate,
+            (s.endColor.y - s.startColor.y) * rate,
+            (s.endColor.z - s.startColor.z) * rate,
+            (s.endColor.w - s.startColor.w) * rate,
+        };
+        float acceleration[3] = {
+            s.acceleration.x * dt, s.acceleration.y * dt, s.acceleration.z * dt};
+
+        float* position[3] = {streams[PositionX], streams[PositionY], streams[PositionZ]};
+        float* velocity[3] = {streams[VelocityX], streams[VelocityY], streams[VelocityZ]};
+        float* color[4] = {streams[ColorR], streams[ColorG], streams[ColorB], streams[ColorA]};
+        float* life = streams[Life];
+
+        size_t i = begin;
+#if defined(__SSE2__)
+        __m128 step = _mm_set1_ps(dt);
+        __m128 damp = _mm_set1_ps(damping);
+        for (; i + 4 <= end; i += 4) {
+            for (int axis = 0; axis < 3; axis++) {
+                __m128 v = _mm_loadu_ps(velocity[axis] + i);
+                v = _mm_add_ps(_mm_mul_ps(v, damp), _mm_set1_ps(acceleration[axis]));
+                _mm_storeu_ps(velocity[axis] + i, v);
+                __m128 p = _mm_loadu_ps(position[axis] + i);
+                _mm_storeu_ps(position[axis] + i, _mm_add_ps(p, _mm_mul_ps(v, step)));
+            }
+            for (int channel = 0; channel < 4; channel++) {
+                __m128 c = _mm_loadu_ps(color[channel] + i);
+                _mm_storeu_ps(color[channel] + i, _mm_add_ps(c, _mm_set1_ps(colorStep[channel])));
+            }
+            _mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), step));
+        }
+#endif
+        for (; i < end; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                velocity[axis][i] = velocity[axis][i] * damping + acceleration[axis];
+                position[axis][i] += velocity[axis][i] * dt;
+            }
+            for (int channel = 0; channel < 4; channel++) color[channel][i] += colorStep[channel];
+            life[i] -= dt;
+        }
+    }
+
+    void move(size_t from, size_t to) {
+        for (auto stream : streams) stream[to] = stream[from];
+    }
+
+    // Swap-removes dead particles within [begin, end) and returns the end of the live ones
+    size_t compactChunk(size_t begin, size_t end) {
+        const float* life = streams[Life];
+        for (size_t i = begin; i < end;) {
+            if (life[i] > 0.0f) {
+                i++;
+                continue;
+            }
+            move(--end, i);
+        }
+        return end;
+    }
+
+    // Each chunk now holds its live particles at its front. Fills the holes below the new count
+    // with live particles from above it, so the work is proportional to the number that died.
+    void closeGaps(size_t chunks) {
+        size_t total = 0;
+        for (size_t chunk = 0; chunk < chunks; chunk++) total += live[chunk];
+
+        size_t source = chunks;
+        size_t sourceTop = 0;
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            size_t holeBegin = chunk * ChunkSize + live[chunk];
+            size_t holeEnd = std::min({(chunk + 1) * ChunkSize, count, total});
+
+            for (size_t hole = holeBegin; hole < holeEnd; hole++) {
+                // Step back to the last chunk still holding live particles at or above total
+                while (sourceTop <= std::max(source * ChunkSize, total)) {
+                    source--;
+                    sourceTop = source * ChunkSize + live[source];
+                }
+                move(--sourceTop, hole);
+            }
+        }
+
+        count = total;
+    }
+};
+
+// Draws each emitter as one instanced draw of a quad. Instance data is packed from the particle
+// streams into a stream buffer, positions and sizes as four floats followed by RGBA8 colours.
+class ParticleRenderer {
+    std::unique_ptr<ShaderProgram> program;
+    GLuint vao = 0;
+    GLuint corners = 0;
+    GLuint instanceBuffer = 0;
+    size_t instances = 0;
+
+    static constexpr const char* vertexSource = R"END(
+        #version 330 core
+        in vec2 aCorner;
+        in vec4 aCenter;
+        in vec4 aColor;
+
+        out vec2 vCorner;
+        out vec4 vColor;
+
+        uniform mat4 uTransform;
+
+        void main() {
+            vec3 position = aCenter.xyz + vec3(aCorner * aCenter.w, 0.0);
+            gl_Position = uTransform * vec4(position, 1.0);
+            vCorner = aCorner;
+            vColor = aColor;
+        }
+    )END";
+
+    static constexpr const char* fragmentSource = R"END(
+        #version 330 core
+        in vec2 vCorner;
+        in vec4 vColor;
+        out vec4 color;
+
+        void main() {
+            float falloff = clamp(1.0 - dot(vCorner, vCorner), 0.0, 1.0);
+            color = vec4(vColor.rgb, vColor.a * falloff);
+        }
+    )END";
+
+    ParticleRenderer() = default;
+
+  public:
+    ~ParticleRenderer() {
+        glDeleteBuffers(1, &corners);
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    ParticleRenderer(const ParticleRenderer&) = delete;
+    ParticleRenderer& operator=(const ParticleRenderer&) = delete;
+
+    static std::unique_ptr<ParticleRenderer> create() {
+        std::unique_ptr<ParticleRenderer> renderer(new ParticleRenderer());
+        renderer->program = ShaderProgram::create(vertexSource, fragmentSource);
+        if (!renderer->program) return nullptr;
+
+        const float quad[] = {-1, -1, 1, -1, -1, 1, 1, 1};
+        glGenVertexArrays(1, &renderer->vao);
+        glGenBuffers(1, &renderer->corners);
+
+        glBindVertexArray(renderer->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, renderer->corners);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+        auto corner = renderer->program->getAttributeLocation("aCorner");
+        glVertexAttribPointer(corner, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glEnableVertexAttribArray(corner);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        return renderer;
+    }
+
+    // Bytes of stream buffer one frame of the emitter needs
+    static size_t instanceBytes(size_t count) { return count * (4 * sizeof(float) + 4); }
+
+    // Packs the emitter's particles into this frame's region of stream, which must target
+    // GL_ARRAY_BUFFER. On the orphaning path the stream has to be committed before draw is called.
+    bool upload(const ParticleEmitter& emitter, StreamBuffer& stream,
+        ThreadPool& pool = ThreadPool::instance()) {
+        instances = emitter.size();
+        if (instances == 0) return true;
+
+        auto allocation = stream.allocate(instanceBytes(instances));
+        if (!allocation) {
+            std::cout << "Stream buffer is too small for the particles" << std::endl;
+            instances = 0;
+            return false;
+        }
+
+        auto centers = static_cast<float*>(allocation->pointer);
+        auto colors = reinterpret_cast<uint32_t*>(centers + instances * 4);
+        pool.parallelFor(instances, ParticleEmitter::ChunkSize,
+            [&](size_t begin, size_t end) { pack(emitter, begin, end, centers, colors); });
+
+        instanceBuffer = stream.id;
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        auto center = program->getAttributeLocation("aCenter");
+        glVertexAttribPointer(center, 4, GL_FLOAT, GL_FALSE, 0, (void*)allocation->offset);
+        glVertexAttribDivisor(center, 1);
+        glEnableVertexAttribArray(center);
+        auto color = program->getAttributeLocation("aColor");
+        glVertexAttribPointer(color, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0,
+            (void*)(allocation->offset + instances * 4 * sizeof(float)));
+        glVertexAttribDivisor(color, 1);
+        glEnableVertexAttribArray(color);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return true;
+    }
+
+    // Additively blends the uploaded particles without writing depth. The caller's blend and
+    // depth write state is restored afterwards.
+    void draw(const Matrix4& transform) {
+        if (instances == 0) return;
+
+        program->use();
+        program->setUniform("uTransform", transform);
+
+        GLboolean blend = glIsEnabled(GL_BLEND);
+        GLboolean depthMask;
+        GLint srcRgb, dstRgb, srcAlpha, dstAlpha;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        glGetIntegerv(GL_BLEND_SRC_RGB, &srcRgb);
+        glGetIntegerv(GL_BLEND_DST_RGB, &dstRgb);
+        glGetIntegerv(GL_BLEND_SRC_ALPHA, &srcAlpha);
+        glGetIntegerv(GL_BLEND_DST_ALPHA, &dstAlpha);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(vao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances);
+        glBindVertexArray(0);
+
+        glDepthMask(depthMask);
+        glBlendFuncSeparate(srcRgb, dstRgb, srcAlpha, dstAlpha);
+        if (!blend) glDisable(GL_BLEND);
+    }
+
+    static void pack(const ParticleEmitter& emitter, size_t begin, size_t end, float* centers,
+        uint32_t* colors) {
+        using Stream = ParticleEmitter::Stream;
+        const float* x = emitter.stream(Stream::PositionX);
+        const float* y = emitter.stream(Stream::PositionY);
+        const float* z = emitter.stream(Stream::PositionZ);
+        const float* size = emitter.stream(Stream::Size);
+        const float* r = emitter.stream(Stream::ColorR);
+        const float* g = emitter.stream(Stream::ColorG);
+        const float* b = emitter.stream(Stream::ColorB);
+        const float* a = emitter.stream(Stream::ColorA);
+
+        size_t i = begin;
+#if defined(__SSE2__)
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 byte = _mm_set1_ps(255.0f);
+        __m128 half = _mm_set1_ps(0.5f);
+        // Adds a half and truncates, rounding exactly like the scalar tail below
+        auto channel = [&](const float* source, int shift) {
+            __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i), zero), one);
+            __m128i quantized = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, byte), half));
+            return _mm_sll_epi32(quantized, _mm_cvtsi32_si128(shift));
+        };
+        for (; i + 4 <= end; i += 4) {
+            __m128 c0 = _mm_loadu_ps(x + i), c1 = _mm_loadu_ps(y + i);
+            __m128 c2 = _mm_loadu_ps(z + i), c3 = _mm_loadu_ps(size + i);
+            _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+            _mm_storeu_ps(centers + i * 4, c0);
+            _mm_storeu_ps(centers + i * 4 + 4, c1);
+            _mm_storeu_ps(centers + i * 4 + 8, c2);
+            _mm_storeu_ps(centers + i * 4 + 12, c3);
+
+            __m128i packed = _mm_or_si128(_mm_or_si128(channel(r, 0), channel(g, 8)),
+                _mm_or_si128(channel(b, 16), channel(a, 24)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(colors + i), packed);
+        }
+#endif
+        auto quantize = [](float value) {
+            return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+        };
+        for (; i < end; i++) {
+            centers[i * 4] = x[i];
+            centers[i * 4 + 1] = y[i];
+            centers[i * 4 + 2] = z[i];
+            centers[i * 4 + 3] = size[i];
+            colors[i] = quantize(r[i]) | quantize(g[i]) << 8 | quantize(b[i]) << 16 |
+                        quantize(a[i]) << 24;
+        }
+    }
+};
@@ -107,6 +107,12 @@ struct ShaderProgram {
         glUniformMatrix4fv(glGetUniformLocation(id, name.c_str()), 1, GL_TRUE, pointer);
     }
 
+    // Points a named uniform block at a uniform buffer binding point
+    void bindUniformBlock(const std::string& name, unsigned binding) {
+        auto index = glGetUniformBlockIndex(id, name.c_str());
+        if (index != GL_INVALID_INDEX) glUniformBlockBinding(id, index, binding);
+    }
+
     static std::unique_ptr<ShaderProgram> create(std::string vertex, std::string fragment) {
         auto vertexShader = ShaderStage::create(ShaderType::Vertex, vertex);
         auto fragmentShader = ShaderStage::create(ShaderType::Fragment, fragment);
@@ -0,0 +1,340 @@
+#pragma once
+
+#include "Animation.h"
+#include "Graphics.h"
+#include "Math.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "ThreadPool.h"
+#include "UniformBlock.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <glad/glad.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// A joint hierarchy stored as flat arrays. Parents always precede their children, so a single
+// forward pass over the arrays visits every parent before anything that depends on it.
+struct Skeleton {
+    static constexpr int16_t Root = -1;
+
+    std::vector<int16_t> parents;
+    std::vector<Matrix4> inverseBind;
+
+    // Returns the new joint's index, its parent must already have been added
+    int16_t addJoint(int16_t parent, const Matrix4& inverseBindMatrix) {
+        assert((parent == Root || (parent >= 0 && static_cast<size_t>(parent) < size())) &&
+               "A joint's parent must be added before it");
+        parents.push_back(parent);
+        inverseBind.push_back(inverseBindMatrix);
+        return parents.size() - 1;
+    }
+
+    size_t size() const { return parents.size(); }
+};
+
+// Local transforms of every joint and the matrices derived from them
+struct Pose {
+    std::vector<Transform> local;
+    std::vector<Matrix4> model;
+    std::vector<Matrix4> skinning;
+
+    Pose(const Skeleton& skeleton)
+        : local(skeleton.size()), model(skeleton.size()), skinning(skeleton.size()) {}
+
+    static Matrix4 toMatrix(const Transform& transform) {
+        auto& t = transform.translation;
+        auto& s = transform.scale;
+        return Matrix4::translate(t.x, t.y, t.z) * Matrix4::rotateZ(transform.rotation) *
+               Matrix4::scale(s.x, s.y, s.z);
+    }
+
+    // Concatenates local transforms down the hierarchy, then applies the inverse bind matrices
+    void evaluate(const Skeleton& skeleton) {
+        for (size_t i = 0; i < skeleton.size(); i++) {
+            Matrix4 matrix = toMatrix(local[i]);
+            int16_t parent = skeleton.parents[i];
+            model[i] = parent == Skeleton::Root ? matrix : model[parent] * matrix;
+        }
+
+        for (size_t i = 0; i < skeleton.size(); i++) {
+            skinning[i] = model[i] * skeleton.inverseBind[i];
+        }
+    }
+};
+
+// Up to four joint influences per vertex, weights summing to one
+struct SkinWeights {
+    uint16_t joints[4];
+    float weights[4];
+};
+
+// Bind pose geometry in the VertexArrayBuilder layout plus its skin weights
+struct SkinnedMesh {
+    using Component = VertexArrayBuilder::Component;
+
+    std::vector<Component> vertices;
+    std::vector<SkinWeights> weights;
+    std::vector<uint32_t> indices;
+    size_t jointCount = 0;
+
+    // Needs exactly one set of weights per vertex, each naming only joints of the skeleton, an
+    // empty mesh is returned otherwise
+    static SkinnedMesh create(const VertexArrayBuilder& builder, std::vector<SkinWeights> weights,
+        const Skeleton& skeleton) {
+        SkinnedMesh mesh;
+        size_t count = builder.data.size() * sizeof(float) / sizeof(Component);
+        if (weights.size() != count) {
+            std::cout << "Skin has " << weights.size() << " weights for " << count << " vertices"
+                      << std::endl;
+            return mesh;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            for (auto joint : weights[i].joints) {
+                if (joint < skeleton.size()) continue;
+                std::cout << "Vertex " << i << " uses joint " << joint << " of a skeleton with "
+                          << skeleton.size() << " joints" << std::endl;
+                return mesh;
+            }
+        }
+
+        mesh.vertices.resize(count);
+        std::memcpy(mesh.vertices.data(), builder.data.data(), count * sizeof(Component));
+        mesh.weights = std::move(weights);
+        mesh.indices.assign(builder.indices.begin(), builder.indices.end());
+        mesh.jointCount = skeleton.size();
+        return mesh;
+    }
+
+    size_t vertexCount() const { return vertices.size(); }
+};
+
+namespace Skinning {
+
+// A skinning matrix stored by columns, so transforming a point is a sum of scaled columns
+struct alignas(16) JointColumns {
+    float columns[16];
+};
+
+inline void preparePalette(const Pose& pose, std::vector<JointColumns>& palette) {
+    palette.resize(pose.skinning.size());
+    for (size_t j = 0; j < pose.skinning.size(); j++) {
+        auto& matrix = pose.skinning[j].data;
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                palette[j].columns[column * 4 + row] = matrix[row * 4 + column];
+            }
+        }
+    }
+}
+
+// Linear blend skinning of vertices [begin, end) into output, which has the same layout as the
+// bind pose and may point straight into a mapped vertex buffer. The palette must hold a matrix
+// for every joint of the mesh's skeleton.
+inline void skin(const SkinnedMesh& mesh, const std::vector<JointColumns>& palette, size_t begin,
+    size_t end, VertexArrayBuilder::Component* output) {
+    assert(palette.size() >= mesh.jointCount && "Palette is missing joints of the skeleton");
+    for (size_t i = begin; i < end; i++) {
+        auto& source = mesh.vertices[i];
+        auto& skin = mesh.weights[i];
+        auto& target = output[i];
+
+#if defined(__SSE2__)
+        __m128 c0 = _mm_setzero_ps(), c1 = _mm_setzero_ps();
+        __m128 c2 = _mm_setzero_ps(), c3 = _mm_setzero_ps();
+        for (int k = 0; k < 4; k++) {
+            __m128 w = _mm_set1_ps(skin.weights[k]);
+            const float* m = palette[skin.joints[k]].columns;
+            c0 = _mm_add_ps(c0, _mm_mul_ps(w, _mm_load_ps(m)));
+            c1 = _mm_add_ps(c1, _mm_mul_ps(w, _mm_load_ps(m + 4)));
+            c2 = _mm_add_ps(c2, _mm_mul_ps(w, _mm_load_ps(m + 8)));
+            c3 = _mm_add_ps(c3, _mm_mul_ps(w, _mm_load_ps(m + 12)));
+        }
+
+        __m128 position = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(source.x)), _mm_mul_ps(c1, _mm_set1_ps(source.y))),
+            _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(source.z)), c3));
+        __m128 normal = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(source.nx)), _mm_mul_ps(c1, _mm_set1_ps(source.ny))),
+            _mm_mul_ps(c2, _mm_set1_ps(source.nz)));
+
+        float n[4];
+        _mm_storeu_ps(&target.x, position);
+        _mm_storeu_ps(n, normal);
+        target.w = source.w;
+        target.nx = n[0];
+        target.ny = n[1];
+        target.nz = n[2];
+#else
+        float c[16] = {};
+        for (int k = 0; k < 4; k++) {
+            const float* m = palette[skin.joints[k]].columns;
+            for (int e = 0; e < 16; e++) c[e] += skin.weights[k] * m[e];
+        }
+
+        target.x = c[0] * source.x + c[4] * source.y + c[8] * source.z + c[12];
+        target.y = c[1] * source.x + c[5] * source.y + c[9] * source.z + c[13];
+        target.z = c[2] * source.x + c[6] * source.y + c[10] * source.z + c[14];
+        target.w = source.w;
+        target.nx = c[0] * source.nx + c[4] * source.ny + c[8] * source.nz;
+        target.ny = c[1] * source.nx + c[5] * source.ny + c[9] * source.nz;
+        target.nz = c[2] * source.nx + c[6] * source.ny + c[10] * source.nz;
+#endif
+        target.u = source.u;
+        target.v = source.v;
+    }
+}
+
+// Skins the whole mesh, splitting the vertices across the pool's workers
+inline void skin(const SkinnedMesh& mesh, const std::vector<JointColumns>& palette,
+    VertexArrayBuilder::Component* output, ThreadPool& pool = ThreadPool::instance()) {
+    pool.parallelFor(mesh.vertexCount(), 4096,
+        [&](size_t begin, size_t end) { skin(mesh, palette, begin, end, output); });
+}
+
+// Skins the mesh straight into this frame's region of a stream buffer
+inline std::optional<StreamBuffer::Allocation> skin(const SkinnedMesh& mesh,
+    const std::vector<JointColumns>& palette, StreamBuffer& stream,
+    ThreadPool& pool = ThreadPool::instance()) {
+    auto allocation = stream.allocate(mesh.vertexCount() * sizeof(VertexArrayBuilder::Component));
+    if (!allocation) return std::nullopt;
+
+    skin(mesh, palette, static_cast<VertexArrayBuilder::Component*>(allocation->pointer), pool);
+    return allocation;
+}
+
+// Joint matrices for skinning in the vertex shader, bound as the "Bones" uniform block
+constexpr unsigned MaxGpuJoints = 64;
+
+struct BonePalette {
+    std::array<Matrix4, MaxGpuJoints> joints;
+};
+
+using BonePaletteBlock = UniformBlock<BonePalette, &BonePalette::joints>;
+
+const auto gpuVertexShaderSource = R"END(
+    #version 330 core
+    in vec4 aPos;
+    in vec2 aTexCoord;
+    in vec3 aNormal;
+    in uvec4 aJoints;
+    in vec4 aWeights;
+
+    out vec2 vTexCoord;
+    out vec3 vNormal;
+
+    layout(std140) uniform Bones {
+        mat4 uJoints[64];
+    };
+
+    uniform mat4 uTransform;
+
+    void main() {
+        mat4 skin = uJoints[aJoints.x] * aWeights.x + uJoints[aJoints.y] * aWeights.y +
+                    uJoints[aJoints.z] * aWeights.z + uJoints[aJoints.w] * aWeights.w;
+        gl_Position = uTransform * skin * vec4(aPos.xyz, 1.0);
+        vNormal = mat3(skin) * aNormal;
+        vTexCoord = aTexCoord;
+    }
+)END";
+
+} // namespace Skinning
+
+// A skinned mesh uploaded once in its bind pose and deformed by the vertex shader
+struct GpuSkinnedMesh {
+    using Component = VertexArrayBuilder::Component;
+
+    VertexArray vao;
+    unsigned binding;
+
+    // Skeletons beyond the shader's palette are refused rather than truncated. The program's
+    // "Bones" block is pointed at binding here, so upload only has to fill that binding.
+    static std::unique_ptr<GpuSkinnedMesh> create(
+        const SkinnedMesh& mesh, ShaderProgram& program, unsigned binding) {
+        if (mesh.jointCount > Skinning::MaxGpuJoints) {
+            std::cout << "Skeleton has " << mesh.jointCount << " joints, the GPU palette holds "
+                      << Skinning::MaxGpuJoints << std::endl;
+            return nullptr;
+        }
+
+        program.bindUniformBlock("Bones", binding);
+        return std::make_unique<GpuSkinnedMesh>(mesh, program, binding);
+    }
+
+    GpuSkinnedMesh(const SkinnedMesh& mesh, ShaderProgram& program, unsigned binding)
+        : binding(binding) {
+        auto vbo = std::make_unique<VertexBuffer>();
+        auto wbo = std::make_unique<VertexBuffer>();
+        auto ebo = std::make_unique<VertexBuffer>();
+        ebo->target = GL_ELEMENT_ARRAY_BUFFER;
+
+        glBindVertexArray(vao.id);
+
+        vbo->bind();
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(Component),
+            mesh.vertices.data(), GL_STATIC_DRAW);
+        attribute(program, "aPos", 4, offsetof(Component, x), sizeof(Component));
+        attribute(program, "aTexCoord", 2, offsetof(Component, u), sizeof(Component));
+        attribute(program, "aNormal", 3, offsetof(Component, nx), sizeof(Component));
+
+        wbo->bind();
+        glBufferData(GL_ARRAY_BUFFER, mesh.weights.size() * sizeof(SkinWeights),
+            mesh.weights.data(), GL_STATIC_DRAW);
+        auto joints = program.getAttributeLocation("aJoints");
+        glVertexAttribIPointer(joints, 4, GL_UNSIGNED_SHORT, sizeof(SkinWeights),
+            (void*)offsetof(SkinWeights, joints));
+        glEnableVertexAttribArray(joints);
+        attribute(program, "aWeights", 4, offsetof(SkinWeights, weights), sizeof(SkinWeights));
+
+        ebo->bind();
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t),
+            mesh.indices.data(), GL_STATIC_DRAW);
+        vao.indexCount = mesh.indices.size();
+
+        glBindVertexArray(0);
+        wbo->unbind();
+
+        vao.addBuffer(std::move(vbo));
+        vao.addBuffer(std::move(wbo));
+        vao.addBuffer(std::move(ebo));
+    }
+
+    // Streams the pose's skinning matrices into the bone block and binds that range. On the
+    // orphaning path the stream has to be committed before draw is called.
+    bool upload(StreamBuffer& stream, const Pose& pose) {
+        if (pose.skinning.size() > Skinning::MaxGpuJoints) {
+            std::cout << "Pose has " << pose.skinning.size() << " joints, the GPU palette holds "
+                      << Skinning::MaxGpuJoints << std::endl;
+            return false;
+        }
+
+        Skinning::BonePalette palette;
+        palette.joints.fill(Matrix4::identity());
+        std::copy(pose.skinning.begin(), pose.skinning.end(), palette.joints.begin());
+        return UniformStream::bind<Skinning::BonePaletteBlock>(stream, binding, palette);
+    }
+
+    void draw(ShaderProgram& program, const Matrix4& transform, DeviceTexture& texture) {
+        vao.draw(program, transform, texture);
+    }
+
+  private:
+    static void attribute(
+        ShaderProgram& program, const std::string& name, int size, size_t offset, size_t stride) {
+        auto location = program.getAttributeLocation(name);
+        glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+        glEnableVertexAttribArray(location);
+    }
+};
@@ -0,0 +1,433 @@
+#pragma once
+
+#include "Graphics.h"
+#include "Math.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// An RGBA8 color target with an optional depth plane. Rows are stored bottom up so the contents
+// compare directly against glReadPixels output.
+struct Framebuffer {
+    int width;
+    int height;
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+
+    Framebuffer(int width, int height)
+        : width(width), height(height), color(width * height), depth(width * height, 1.0f) {}
+
+    static uint32_t pack(float r, float g, float b, float a) {
+        auto channel = [](float value) {
+            return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+        };
+        return channel(r) | channel(g) << 8 | channel(b) << 16 | channel(a) << 24;
+    }
+
+    void clear(float r, float g, float b, float a) {
+        std::fill(color.begin(), color.end(), pack(r, g, b, a));
+        std::fill(depth.begin(), depth.end(), 1.0f);
+    }
+
+    uint32_t pixel(int x, int y) const { return color[y * width + x]; }
+
+    const uint8_t* bytes() const { return reinterpret_cast<const uint8_t*>(color.data()); }
+
+    // Counts pixels where any channel differs by more than tolerance, for image diff tests
+    size_t difference(const Framebuffer& other, int tolerance) const {
+        if (other.width != width || other.height != height) return color.size();
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < color.size(); i++) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                int a = (color[i] >> shift) & 0xff;
+                int b = (other.color[i] >> shift) & 0xff;
+                if (std::abs(a - b) > tolerance) {
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+        return mismatches;
+    }
+};
+
+// Renders VertexArrayBuilder geometry on the cpu with the same conventions as the default
+// shader: positions are multiplied by the transform, colors come from a bilinearly filtered
+// repeating texture, and no blending or culling is applied. Triangles from every draw of a frame
+// are binned into screen tiles which are then rasterized in parallel, each tile by one thread and
+// in submission order, so the result does not depend on scheduling.
+class SoftwareRenderer {
+  public:
+    static constexpr int TileSize = 64;
+
+    bool depthTest = false;
+
+  private:
+    struct Vertex {
+        float x, y, z;
+        float invW;
+        float u, v;
+    };
+
+    struct Triangle {
+        Vertex vertices[3];
+        const HostImage* texture;
+        float area;
+        int minX, minY, maxX, maxY;
+    };
+
+    ThreadPool& pool;
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<uint32_t>> bins;
+    std::vector<Vertex> transformed;
+
+    // Mip levels below the base image, built the first time an image is drawn. Chains are keyed by
+    // address and also remember the pixel storage and size they were built from, so a different
+    // image that reuses the address is rebuilt. Edits to an image in place need invalidate.
+    // Levels are never changed once built, a rebuild makes a new set instead.
+    using MipLevels = std::vector<HostImage>;
+
+    struct MipChain {
+        const uint8_t* source = nullptr;
+        int width = 0;
+        int height = 0;
+        uint64_t lastUsed = 0;
+        std::shared_ptr<const MipLevels> levels;
+    };
+
+    // Frames a chain may go undrawn before begin drops it, which bounds the cache to the images
+    // drawn recently
+    static constexpr uint64_t MipLifetime = 120;
+
+    std::unordered_map<const HostImage*, MipChain> mips;
+    uint64_t frame = 0;
+
+    // Every level set a queued triangle samples, held until the next begin so that invalidating
+    // or redrawing an image before finish cannot free levels the batch still points into
+    std::vector<std::shared_ptr<const MipLevels>> pinned;
+
+  public:
+    SoftwareRenderer(ThreadPool& pool = ThreadPool::instance()) : pool(pool) {}
+
+    // Starts a frame targeting a framebuffer of the given size
+    void begin(int targetWidth, int targetHeight) {
+        width = targetWidth;
+        height = targetHeight;
+        tilesX = (width + TileSize - 1) / TileSize;
+        tilesY = (height + TileSize - 1) / TileSize;
+
+        triangles.clear();
+        pinned.clear();
+        bins.resize(tilesX * tilesY);
+        for (auto& bin : bins) bin.clear();
+
+        frame++;
+        std::erase_if(
+            mips, [&](auto& entry) { return frame - entry.second.lastUsed > MipLifetime; });
+    }
+
+    // Drops the mips built for an image, for when its pixels were changed in place
+    void invalidate(const HostImage& image) { mips.erase(&image); }
+
+    // Queues the geometry for finish. The texture itself is read at finish, so it has to stay
+    // alive and unchanged until then, its mip levels are kept by the renderer.
+    void draw(const VertexArrayBuilder& builder, const Matrix4& transform, const HostImage& texture,
+        Primitive primitive = Primitive::TriangleStrip) {
+        using Component = VertexArrayBuilder::Component;
+        auto components = reinterpret_cast<const Component*>(builder.data.data());
+        size_t count = builder.data.size() * sizeof(float) / sizeof(Component);
+
+        // Transform and project every vertex once, the matrix is row major like the uniform upload
+        auto& m = transform.data;
+        transformed.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            auto& c = components[i];
+            float x = m[0] * c.x + m[1] * c.y + m[2] * c.z + m[3];
+            float y = m[4] * c.x + m[5] * c.y + m[6] * c.z + m[7];
+            float z = m[8] * c.x + m[9] * c.y + m[10] * c.z + m[11];
+            float w = m[12] * c.x + m[13] * c.y + m[14] * c.z + m[15];
+
+            float invW = w > 1e-6f ? 1.0f / w : 0.0f;
+            transformed[i] = {
+                (x * invW + 1.0f) * 0.5f * width,
+                (y * invW + 1.0f) * 0.5f * height,
+                (z * invW + 1.0f) * 0.5f,
+                invW,
+                c.u * invW,
+                c.v * invW,
+            };
+        }
+
+        auto& levels = *pin(mipChain(texture));
+
+        auto& indices = builder.indices;
+        if (primitive == Primitive::Triangles) {
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                setup(indices[i], indices[i + 1], indices[i + 2], texture, levels);
+            }
+        } else {
+            for (size_t i = 0; i + 2 < indices.size(); i++) {
+                setup(indices[i], indices[i + 1], indices[i + 2], texture, levels);
+            }
+        }
+    }
+
+    // Rasterizes everything drawn since begin into the framebuffer
+    void finish(Framebuffer& target) {
+        pool.parallelFor(bins.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t tile = begin; tile < end; tile++) rasterizeTile(target, tile);
+        });
+    }
+
+  private:
+    void setup(uint32_t i0, uint32_t i1, uint32_t i2, const HostImage& texture,
+        const MipLevels& levels) {
+        if (i0 >= transformed.size() || i1 >= transformed.size() || i2 >= transformed.size()) return;
+
+        Triangle triangle;
+        triangle.vertices[0] = transformed[i0];
+        triangle.vertices[1] = transformed[i1];
+        triangle.vertices[2] = transformed[i2];
+        triangle.texture = &texture;
+
+        // Vertices behind the eye are not clipped, the whole triangle is dropped instead
+        auto& v = triangle.vertices;
+        if (v[0].invW <= 0.0f || v[1].invW <= 0.0f || v[2].invW <= 0.0f) return;
+
+        // Culling is off, so clockwise triangles are flipped to keep the edge functions positive
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+        if (area == 0.0f) return;
+        if (area < 0.0f) {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+        triangle.area = area;
+        triangle.texture = selectLevel(triangle, texture, levels);
+
+        float minX = std::min({v[0].x, v[1].x, v[2].x});
+        float maxX = std::max({v[0].x, v[1].x, v[2].x});
+        float minY = std::min({v[0].y, v[1].y, v[2].y});
+        float maxY = std::max({v[0].y, v[1].y, v[2].y});
+
+        triangle.minX = std::max(0, static_cast<int>(std::floor(minX)));
+        triangle.minY = std::max(0, static_cast<int>(std::floor(minY)));
+        triangle.maxX = std::min(width - 1, static_cast<int>(std::ceil(maxX)));
+        triangle.maxY = std::min(height - 1, static_cast<int>(std::ceil(maxY)));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return;
+
+        uint32_t index = triangles.size();
+        triangles.push_back(triangle);
+
+        for (int ty = triangle.minY / TileSize; ty <= triangle.maxY / TileSize; ty++) {
+            for (int tx = triangle.minX / TileSize; tx <= triangle.maxX / TileSize; tx++) {
+                bins[ty * tilesX + tx].push_back(index);
+            }
+        }
+    }
+
+    const std::shared_ptr<const MipLevels>& pin(const std::shared_ptr<const MipLevels>& levels) {
+        if (pinned.empty() || pinned.back() != levels) pinned.push_back(levels);
+        return levels;
+    }
+
+    const std::shared_ptr<const MipLevels>& mipChain(const HostImage& image) {
+        auto& chain = mips[&image];
+        chain.lastUsed = frame;
+        if (chain.levels && chain.source == image.pixels.data() && chain.width == image.width &&
+            chain.height == image.height) {
+            return chain.levels;
+        }
+
+        chain.source = image.pixels.data();
+        chain.width = image.width;
+        chain.height = image.height;
+
+        auto levels = std::make_shared<MipLevels>();
+        if (!image.pixels.empty()) {
+            const HostImage* previous = &image;
+            while (previous->width > 1 || previous->height > 1) {
+                levels->push_back(previous->downsample());
+                previous = &levels->back();
+            }
+        }
+        chain.levels = std::move(levels);
+        return chain.levels;
+    }
+
+    // Picks one mip level per triangle from the ratio of its texel area to its pixel area. This
+    // approximates the trilinear filtering of the GL path with the nearest level.
+    static const HostImage* selectLevel(
+        const Triangle& triangle, const HostImage& base, const MipLevels& levels) {
+        if (levels.empty() || base.pixels.empty()) return &base;
+
+        auto& v = triangle.vertices;
+        float u[3], t[3];
+        for (int i = 0; i < 3; i++) {
+            u[i] = v[i].u / v[i].invW * base.width;
+            t[i] = v[i].v / v[i].invW * base.height;
+        }
+
+        float texels = std::fabs((u[1] - u[0]) * (t[2] - t[0]) - (t[1] - t[0]) * (u[2] - u[0]));
+        if (texels <= triangle.area) return &base;
+
+        int level = static_cast<int>(0.5f * std::log2(texels / triangle.area) + 0.5f);
+        if (level <= 0) return &base;
+        return &levels[std::min<size_t>(level, levels.size()) - 1];
+    }
+
+    void rasterizeTile(Framebuffer& target, size_t tile) {
+        int tileX = (tile % tilesX) * TileSize;
+        int tileY = (tile / tilesX) * TileSize;
+
+        for (uint32_t index : bins[tile]) {
+            auto& triangle = triangles[index];
+            int x0 = std::max(triangle.minX, tileX);
+            int y0 = std::max(triangle.minY, tileY);
+            int x1 = std::min(triangle.maxX, std::min(tileX + TileSize, width) - 1);
+            int y1 = std::min(triangle.maxY, std::min(tileY + TileSize, height) - 1);
+            if (x0 > x1 || y0 > y1) continue;
+
+            rasterize(target, triangle, x0, y0, x1, y1);
+        }
+    }
+
+    // Edge function of the directed edge a -> b as e(x, y) = A x + B y + C
+    struct Edge {
+        float a, b, c;
+
+        Edge(const Vertex& from, const Vertex& to)
+            : a(from.y - to.y), b(to.x - from.x), c(from.x * to.y - from.y * to.x) {}
+
+        float at(float x, float y) const { return a * x + b * y + c; }
+    };
+
+    void rasterize(Framebuffer& target, const Triangle& triangle, int x0, int y0, int x1, int y1) {
+        auto& v = triangle.vertices;
+        Edge e0(v[1], v[2]), e1(v[2], v[0]), e2(v[0], v[1]);
+        float invArea = 1.0f / triangle.area;
+
+        for (int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            int x = x0;
+
+#if defined(__SSE2__)
+            // Four pixels per step, only covered lanes are shaded
+            __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            for (; x + 3 <= x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+                __m128 w0 = edge(e0, px, py);
+                __m128 w1 = edge(e1, px, py);
+                __m128 w2 = edge(e2, px, py);
+
+                __m128 inside = _mm_min_ps(w0, _mm_min_ps(w1, w2));
+                int mask = _mm_movemask_ps(_mm_cmpge_ps(inside, _mm_setzero_ps()));
+                if (mask == 0) continue;
+
+                alignas(16) float b0[4], b1[4], b2[4];
+                _mm_store_ps(b0, w0);
+                _mm_store_ps(b1, w1);
+                _mm_store_ps(b2, w2);
+                for (int lane = 0; lane < 4; lane++) {
+                    if (mask & (1 << lane)) {
+                        shade(target, triangle, x + lane, y, b0[lane] * invArea,
+                            b1[lane] * invArea, b2[lane] * invArea);
+                    }
+                }
+            }
+#endif
+            for (; x <= x1; x++) {
+                float px = x + 0.5f;
+                float w0 = e0.at(px, py), w1 = e1.at(px, py), w2 = e2.at(px, py);
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+                shade(target, triangle, x, y, w0 * invArea, w1 * invArea, w2 * invArea);
+            }
+        }
+    }
+
+#if defined(__SSE2__)
+    static __m128 edge(const Edge& e, __m128 px, float py) {
+        return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e.a), px), _mm_set1_ps(e.b * py + e.c));
+    }
+#endif
+
+    void shade(Framebuffer& target, const Triangle& triangle, int x, int y, float l0, float l1,
+        float l2) {
+        auto& v = triangle.vertices;
+        size_t pixel = y * target.width + x;
+
+        if (depthTest) {
+            float z = l0 * v[0].z + l1 * v[1].z + l2 * v[2].z;
+            if (z >= target.depth[pixel]) return;
+            target.depth[pixel] = z;
+        }
+
+        // Attributes were divided by w at setup, dividing by the interpolated 1 / w restores them
+        float invW = l0 * v[0].invW + l1 * v[1].invW + l2 * v[2].invW;
+        float u = (l0 * v[0].u + l1 * v[1].u + l2 * v[2].u) / invW;
+        float t = (l0 * v[0].v + l1 * v[1].v + l2 * v[2].v) / invW;
+
+        target.color[pixel] = sample(*triangle.texture, u, t);
+    }
+
+    static int floorToInt(float value) {
+        int truncated = static_cast<int>(value);
+        return value < truncated ? truncated - 1 : truncated;
+    }
+
+    static int wrap(int value, int size) {
+        if ((size & (size - 1)) == 0) return value & (size - 1);
+        value %= size;
+        return value < 0 ? value + size : value;
+    }
+
+    static uint32_t texel(const HostImage& image, int x, int y) {
+        uint32_t value;
+        std::memcpy(&value, &image.pixels[(y * image.width + x) * 4], sizeof(value));
+        return value;
+    }
+
+    // Blends two packed RGBA8 colors with an 8 bit weight, two channels per multiply
+    static uint32_t lerp(uint32_t a, uint32_t b, uint32_t weight) {
+        uint32_t inverse = 256 - weight;
+        uint32_t rb = ((a & 0x00ff00ff) * inverse + (b & 0x00ff00ff) * weight) >> 8;
+        uint32_t ag = ((a >> 8) & 0x00ff00ff) * inverse + ((b >> 8) & 0x00ff00ff) * weight;
+        return (rb & 0x00ff00ff) | (ag & 0xff00ff00);
+    }
+
+    // Bilinear filtering with repeat wrapping, matching the texture parameters DeviceTexture sets
+    static uint32_t sample(const HostImage& image, float u, float v) {
+        if (image.pixels.empty()) return 0xffffffff;
+
+        float fx = u * image.width - 0.5f;
+        float fy = v * image.height - 0.5f;
+        int ix = floorToInt(fx);
+        int iy = floorToInt(fy);
+        auto ax = static_cast<uint32_t>((fx - ix) * 256.0f);
+        auto ay = static_cast<uint32_t>((fy - iy) * 256.0f);
+
+        int x0 = wrap(ix, image.width), x1 = wrap(ix + 1, image.width);
+        int y0 = wrap(iy, image.height), y1 = wrap(iy + 1, image.height);
+
+        uint32_t top = lerp(texel(image, x0, y0), texel(image, x1, y0), ax);
+        uint32_t bottom = lerp(texel(image, x0, y1), texel(image, x1, y1), ax);
+        return lerp(top, bottom, ay);
+    }
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+
+#include <glad/glad.h>
+
+// A ring of per frame regions inside one buffer that the cpu writes into while the gpu is still
+// reading the regions of earlier frames. With buffer storage the whole buffer stays persistently
+// and coherently mapped, and a fence per region keeps the cpu from overwriting data in flight.
+// Without it each frame orphans the buffer and maps it afresh, letting the driver do the renaming.
+struct StreamBuffer {
+    static constexpr unsigned FramesInFlight = 3;
+
+    // A suballocation valid until the end of the frame it was made in
+    struct Allocation {
+        void* pointer;
+        size_t offset;
+        size_t size;
+    };
+
+    GLenum target;
+    GLuint id;
+    size_t frameSize;
+    bool persistent;
+
+    unsigned frame = 0;
+    size_t head = 0;
+    uint8_t* mapped = nullptr;
+    // Buffer offset the mapping starts at, only past zero when remapped after a commit
+    size_t mappedOffset = 0;
+    std::array<GLsync, FramesInFlight> fences = {};
+
+    StreamBuffer(GLenum target, size_t frameSize)
+        : target(target), frameSize(frameSize), persistent(GLAD_GL_VERSION_4_4) {
+        glGenBuffers(1, &id);
+        glBindBuffer(target, id);
+
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(target, capacity(), nullptr, flags);
+            mapped = static_cast<uint8_t*>(glMapBufferRange(target, 0, capacity(), flags));
+        } else {
+            glBufferData(target, frameSize, nullptr, GL_STREAM_DRAW);
+        }
+
+        glBindBuffer(target, 0);
+    }
+
+    ~StreamBuffer() {
+        for (auto& fence : fences) {
+            if (fence) glDeleteSync(fence);
+        }
+
+        if (mapped) {
+            glBindBuffer(target, id);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+        }
+
+        glDeleteBuffers(1, &id);
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    static std::unique_ptr<StreamBuffer> create(GLenum target, size_t frameSize) {
+        auto buffer = std::make_unique<StreamBuffer>(target, frameSize);
+        if (buffer->persistent && !buffer->mapped) {
+            std::cout << "Failed to map stream buffer" << std::endl;
+            return nullptr;
+        }
+        return buffer;
+    }
+
+    // Total size of the gpu storage, one region per frame in flight when persistently mapped
+    size_t capacity() const { return persistent ? frameSize * FramesInFlight : frameSize; }
+
+    // Offset of the current frame's region from the start of the buffer
+    size_t base() const { return persistent ? frame * frameSize : 0; }
+
+    void bind() { glBindBuffer(target, id); }
+
+    void unbind() { glBindBuffer(target, 0); }
+
+    // Waits until the gpu has finished with the region this frame is about to reuse
+    void beginFrame() {
+        head = 0;
+        mappedOffset = 0;
+
+        if (persistent) {
+            auto& fence = fences[frame];
+            if (fence) {
+                GLenum status = glClientWaitSync(fence, 0, 0);
+                while (status == GL_TIMEOUT_EXPIRED) {
+                    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+                }
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+            return;
+        }
+
+        // Orphan the old storage, then map the new storage without synchronising against it
+        bind();
+        glBufferData(target, frameSize, nullptr, GL_STREAM_DRAW);
+        GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        mapped = static_cast<uint8_t*>(glMapBufferRange(target, 0, frameSize, flags));
+        unbind();
+    }
+
+    // Bumps a range out of the current frame's region, the offset is relative to the whole buffer.
+    // The alignment applies to that whole-buffer offset, since that is what gets bound.
+    std::optional<Allocation> allocate(size_t size, size_t alignment = 16) {
+        size_t start = (base() + head + alignment - 1) / alignment * alignment - base();
+        if (start + size > frameSize) return std::nullopt;
+        if (!mapped && (persistent || !remap(start))) return std::nullopt;
+
+        head = start + size;
+        return Allocation{mapped + base() + start - mappedOffset, base() + start, size};
+    }
+
+    // Makes this frame's writes visible to draws. Only the orphaning path has anything to do, a
+    // coherent persistent mapping is visible as soon as it is written. Allocating again after a
+    // commit maps the rest of the region, so uploads and draws can interleave within a frame.
+    void commit() {
+        if (persistent || !mapped) return;
+
+        bind();
+        glUnmapBuffer(target);
+        unbind();
+        mapped = nullptr;
+    }
+
+    // Maps the unused rest of the region after a commit. Draws so far only read below start, so the
+    // mapping needs no synchronisation.
+    bool remap(size_t start) {
+        bind();
+        GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        mapped = static_cast<uint8_t*>(glMapBufferRange(target, start, frameSize - start, flags));
+        unbind();
+        mappedOffset = start;
+        return mapped != nullptr;
+    }
+
+    // Fences the commands that read this frame's region and moves on to the next region
+    void endFrame() {
+        commit();
+
+        if (persistent) {
+            fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            frame = (frame + 1) % FramesInFlight;
+        }
+    }
+};
@@ -0,0 +1,696 @@
+#pragma once
+
+#include "Math.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+// A glyph's coverage at high resolution, one byte per pixel with rows stored top down. Metrics are
+// in the same pixels, relative to the pen position on the baseline.
+struct GlyphBitmap {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> coverage;
+    float bearingX = 0;
+    float bearingY = 0;
+    float advance = 0;
+};
+
+// Produces glyph outlines for the atlas. Rasterizing is called from worker threads.
+struct GlyphSource {
+    virtual ~GlyphSource() = default;
+
+    // Identifies the source in the disk cache
+    virtual std::string name() const = 0;
+
+    // Height of one em in the source's pixels
+    virtual float pixelsPerEm() const = 0;
+
+    // Distance between baselines in the source's pixels
+    virtual float lineHeight() const { return pixelsPerEm(); }
+
+    // Changes whenever the glyphs produced change, so atlases cached from older glyphs are rebuilt
+    virtual uint64_t version() const = 0;
+
+    virtual std::optional<GlyphBitmap> rasterize(uint32_t codepoint) const = 0;
+};
+
+// The classic 5x7 ASCII bitmap font, scaled up so its distance field has room to resolve corners.
+// There is no font rasterizer in the tree, so this keeps text self contained.
+struct BuiltinFont : GlyphSource {
+    static constexpr int Scale = 16;
+    static constexpr int Columns = 5;
+    static constexpr int Rows = 7;
+
+    std::string name() const override { return "builtin-5x7"; }
+
+    float pixelsPerEm() const override { return (Rows + 2) * Scale; }
+
+    float lineHeight() const override { return (Rows + 4) * Scale; }
+
+    // A hash of the glyph table and scale
+    uint64_t version() const override {
+        uint64_t hash = 14695981039346656037ull;
+        for (auto& columns : glyphs) {
+            for (uint8_t column : columns) hash = (hash ^ column) * 1099511628211ull;
+        }
+        return (hash ^ Scale) * 1099511628211ull;
+    }
+
+    std::optional<GlyphBitmap> rasterize(uint32_t codepoint) const override {
+        if (codepoint < 32 || codepoint > 126) return std::nullopt;
+        const uint8_t* columns = glyphs[codepoint - 32];
+
+        GlyphBitmap bitmap;
+        bitmap.width = Columns * Scale;
+        bitmap.height = Rows * Scale;
+        bitmap.coverage.resize(bitmap.width * bitmap.height);
+        bitmap.bearingX = 0;
+        bitmap.bearingY = Rows * Scale;
+        bitmap.advance = (Columns + 1) * Scale;
+
+        // Each byte is a column with the top row in the lowest bit
+        for (int y = 0; y < bitmap.height; y++) {
+            for (int x = 0; x < bitmap.width; x++) {
+                bool set = columns[x / Scale] >> (y / Scale) & 1;
+                bitmap.coverage[y * bitmap.width + x] = set ? 255 : 0;
+            }
+        }
+        return bitmap;
+    }
+
+  private:
+    static constexpr uint8_t glyphs[95][5] = {
+        {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5f, 0x00, 0x00},
+        {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7f, 0x14, 0x7f, 0x14},
+        {0x24, 0x2a, 0x7f, 0x2a, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+        {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00},
+        {0x00, 0x1c, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1c, 0x00},
+        {0x14, 0x08, 0x3e, 0x08, 0x14}, {0x08, 0x08, 0x3e, 0x08, 0x08},
+        {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08},
+        {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02},
+        {0x3e, 0x51, 0x49, 0x45, 0x3e}, {0x00, 0x42, 0x7f, 0x40, 0x00},
+        {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4b, 0x31},
+        {0x18, 0x14, 0x12, 0x7f, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39},
+        {0x3c, 0x4a, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+        {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1e},
+        {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00},
+        {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},
+        {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06},
+        {0x32, 0x49, 0x79, 0x41, 0x3e}, {0x7e, 0x11, 0x11, 0x11, 0x7e},
+        {0x7f, 0x49, 0x49, 0x49, 0x36}, {0x3e, 0x41, 0x41, 0x41, 0x22},
+        {0x7f, 0x41, 0x41, 0x22, 0x1c}, {0x7f, 0x49, 0x49, 0x49, 0x41},
+        {0x7f, 0x09, 0x09, 0x09, 0x01}, {0x3e, 0x41, 0x49, 0x49, 0x7a},
+        {0x7f, 0x08, 0x08, 0x08, 0x7f}, {0x00, 0x41, 0x7f, 0x41, 0x00},
+        {0x20, 0x40, 0x41, 0x3f, 0x01}, {0x7f, 0x08, 0x14, 0x22, 0x41},
+        {0x7f, 0x40, 0x40, 0x40, 0x40}, {0x7f, 0x02, 0x0c, 0x02, 0x7f},
+        {0x7f, 0x04, 0x08, 0x10, 0x7f}, {0x3e, 0x41, 0x41, 0x41, 0x3e},
+        {0x7f, 0x09, 0x09, 0x09, 0x06}, {0x3e, 0x41, 0x51, 0x21, 0x5e},
+        {0x7f, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31},
+        {0x01, 0x01, 0x7f, 0x01, 0x01}, {0x3f, 0x40, 0x40, 0x40, 0x3f},
+        {0x1f, 0x20, 0x40, 0x20, 0x1f}, {0x3f, 0x40, 0x38, 0x40, 0x3f},
+        {0x63, 0x14, 0x08, 0x14, 0x63}, {0x07, 0x08, 0x70, 0x08, 0x07},
+        {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7f, 0x41, 0x41, 0x00},
+        {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7f, 0x00},
+        {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40},
+        {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78},
+        {0x7f, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20},
+        {0x38, 0x44, 0x44, 0x48, 0x7f}, {0x38, 0x54, 0x54, 0x54, 0x18},
+        {0x08, 0x7e, 0x09, 0x01, 0x02}, {0x0c, 0x52, 0x52, 0x52, 0x3e},
+        {0x7f, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7d, 0x40, 0x00},
+        {0x20, 0x40, 0x44, 0x3d, 0x00}, {0x7f, 0x10, 0x28, 0x44, 0x00},
+        {0x00, 0x41, 0x7f, 0x40, 0x00}, {0x7c, 0x04, 0x18, 0x04, 0x78},
+        {0x7c, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38},
+        {0x7c, 0x14, 0x14, 0x14, 0x08}, {0x08, 0x14, 0x14, 0x18, 0x7c},
+        {0x7c, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},
+        {0x04, 0x3f, 0x44, 0x40, 0x20}, {0x3c, 0x40, 0x40, 0x20, 0x7c},
+        {0x1c, 0x20, 0x40, 0x20, 0x1c}, {0x3c, 0x40, 0x30, 0x40, 0x3c},
+        {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0c, 0x50, 0x50, 0x50, 0x3c},
+        {0x44, 0x64, 0x54, 0x4c, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00},
+        {0x00, 0x00, 0x7f, 0x00, 0x00}, {0x00, 0x41, 0x36, 0x08, 0x00},
+        {0x10, 0x08, 0x08, 0x10, 0x08},
+    };
+};
+
+namespace DistanceField {
+
+// Squared distance transform of a sampled function along one line (Felzenszwalb and Huttenlocher)
+inline void transform1d(const float* f, float* d, int n, int* v, float* z) {
+    constexpr float Infinity = std::numeric_limits<float>::infinity();
+    int k = 0;
+    v[0] = 0;
+    z[0] = -Infinity;
+    z[1] = Infinity;
+
+    for (int q = 1; q < n; q++) {
+        float s;
+        while (true) {
+            int p = v[k];
+            s = ((f[q] + q * q) - (f[p] + p * p)) / (2.0f * q - 2.0f * p);
+            if (s > z[k] || k == 0) break;
+            k--;
+        }
+        if (s <= z[k]) {
+            // Only reached with k == 0 when f[v[0]] is infinite
+            v[0] = q;
+            z[0] = -Infinity;
+            z[1] = Infinity;
+            continue;
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = Infinity;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[k + 1] < q) k++;
+        float delta = q - v[k];
+        d[q] = delta * delta + f[v[k]];
+    }
+}
+
+// Squared euclidean distance from every pixel to the nearest pixel where feature is true
+inline std::vector<float> transform2d(const std::vector<bool>& feature, int width, int height) {
+    constexpr float Far = 1e20f;
+    int n = std::max(width, height);
+    std::vector<float> grid(width * height), f(n), d(n), z(n + 1);
+    std::vector<int> v(n);
+
+    for (int i = 0; i < width * height; i++) grid[i] = feature[i] ? 0.0f : Far;
+
+    for (int x = 0; x < width; x++) {
+        for (int y = 0; y < height; y++) f[y] = grid[y * width + x];
+        transform1d(f.data(), d.data(), height, v.data(), z.data());
+        for (int y = 0; y < height; y++) grid[y * width + x] = d[y];
+    }
+
+    for (int y = 0; y < height; y++) {
+        transform1d(&grid[y * width], d.data(), width, v.data(), z.data());
+        std::copy_n(d.data(), width, &grid[y * width]);
+    }
+
+    return grid;
+}
+
+} // namespace DistanceField
+
+// A single channel atlas of signed distance fields, 128 on the outline and rising inwards. Glyphs
+// are generated in parallel, shelf packed, and the result can be cached on disk.
+struct GlyphAtlas {
+    struct Glyph {
+        uint32_t codepoint;
+        float u0, v0, u1, v1;
+        // Quad placement relative to the pen, in ems, y up
+        float left, bottom, right, top;
+        float advance;
+    };
+
+    static constexpr uint32_t Magic = 0x41464453;
+    static constexpr uint32_t Version = 2;
+
+    // Largest atlas side a cache file is trusted with
+    static constexpr uint32_t MaxSize = 16384;
+
+    int size = 0;
+    int glyphPixelsPerEm = 0;
+    int spread = 0;
+    std::vector<uint8_t> pixels;
+    std::unordered_map<uint32_t, Glyph> glyphs;
+    float lineHeight = 1.0f;
+
+    const Glyph* find(uint32_t codepoint) const {
+        auto found = glyphs.find(codepoint);
+        return found == glyphs.end() ? nullptr : &found->second;
+    }
+
+    // Builds fields for every codepoint in [first, last], pixelsPerEm is the field resolution
+    static std::optional<GlyphAtlas> build(const GlyphSource& source, uint32_t first, uint32_t last,
+        int pixelsPerEm = 32, int spread = 4, int size = 512,
+        ThreadPool& pool = ThreadPool::instance()) {
+        struct Field {
+            uint32_t codepoint = 0;
+            bool present = false;
+            int width = 0, height = 0;
+            std::vector<uint8_t> values;
+            float left = 0, bottom = 0, right = 0, top = 0, advance = 0;
+        };
+
+        std::vector<Field> fields(last - first + 1);
+        float downscale = source.pixelsPerEm() / pixelsPerEm;
+
+        pool.parallelFor(fields.size(), 4, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                fields[i].codepoint = first + i;
+                auto bitmap = source.rasterize(first + i);
+                if (bitmap) generate(*bitmap, downscale, spread, source.pixelsPerEm(), fields[i]);
+            }
+        });
+
+        GlyphAtlas atlas;
+        atlas.size = size;
+        atlas.glyphPixelsPerEm = pixelsPerEm;
+        atlas.spread = spread;
+        atlas.lineHeight = source.lineHeight() / source.pixelsPerEm();
+        atlas.pixels.assign(size * size, 0);
+
+        // Shelf packing, tallest glyphs first so shelves waste little height
+        std::vector<Field*> order;
+        for (auto& field : fields) {
+            if (field.present) order.push_back(&field);
+        }
+        std::sort(order.begin(), order.end(),
+            [](const Field* a, const Field* b) { return a->height > b->height; });
+
+        int x = 0, y = 0, shelf = 0;
+        for (auto* field : order) {
+            if (x + field->width > size) {
+                x = 0;
+                y += shelf + 1;
+                shelf = 0;
+            }
+            if (y + field->height > size) {
+                std::cout << "Glyph atlas is too small" << std::endl;
+                return std::nullopt;
+            }
+
+            for (int row = 0; row < field->height; row++) {
+                std::memcpy(&atlas.pixels[(y + row) * size + x], &field->values[row * field->width],
+                    field->width);
+            }
+
+            Glyph glyph;
+            glyph.codepoint = field->codepoint;
+            glyph.u0 = static_cast<float>(x) / size;
+            glyph.v0 = static_cast<float>(y) / size;
+            glyph.u1 = static_cast<float>(x + field->width) / size;
+            glyph.v1 = static_cast<float>(y + field->height) / size;
+            glyph.left = field->left;
+            glyph.bottom = field->bottom;
+            glyph.right = field->right;
+            glyph.top = field->top;
+            glyph.advance = field->advance;
+            atlas.glyphs[glyph.codepoint] = glyph;
+
+            x += field->width + 1;
+            shelf = std::max(shelf, field->height);
+        }
+
+        return atlas;
+    }
+
+    // Loads the atlas from path if it was built with the same parameters, otherwise builds it
+    // and writes it there
+    static std::optional<GlyphAtlas> loadOrBuild(const std::string& path, const GlyphSource& source,
+        uint32_t first, uint32_t last, int pixelsPerEm = 32, int spread = 4, int size = 512) {
+        uint64_t key = cacheKey(source, first, last, pixelsPerEm, spread, size);
+        if (auto cached = read(path, key)) return cached;
+
+        auto atlas = build(source, first, last, pixelsPerEm, spread, size);
+        if (atlas) atlas->write(path, key);
+        return atlas;
+    }
+
+    // A failed write removes the file, so a truncated cache is never left behind
+    bool write(const std::string& path, uint64_t key) const {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+
+        uint32_t header[8] = {Magic, Version, static_cast<uint32_t>(size),
+            static_cast<uint32_t>(glyphs.size()), static_cast<uint32_t>(key),
+            static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(glyphPixelsPerEm),
+            static_cast<uint32_t>(spread)};
+        bool written = std::fwrite(header, sizeof(header), 1, file) == 1;
+        written = written && std::fwrite(&lineHeight, sizeof(lineHeight), 1, file) == 1;
+        for (auto& [codepoint, glyph] : glyphs) {
+            written = written && std::fwrite(&glyph, sizeof(Glyph), 1, file) == 1;
+        }
+        written = written && std::fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+        written = std::fclose(file) == 0 && written;
+
+        if (!written) {
+            std::cout << "Failed to write glyph atlas: " << path << std::endl;
+            std::remove(path.c_str());
+        }
+        return written;
+    }
+
+  private:
+    static uint64_t cacheKey(const GlyphSource& source, uint32_t first, uint32_t last,
+        int pixelsPerEm, int spread, int size) {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&](uint64_t value) {
+            for (int shift = 0; shift < 64; shift += 8) {
+                hash ^= (value >> shift) & 0xff;
+                hash *= 1099511628211ull;
+            }
+        };
+        for (char c : source.name()) mix(c);
+        mix(source.version());
+        mix(first);
+        mix(last);
+        mix(pixelsPerEm);
+        mix(spread);
+        mix(size);
+        return hash;
+    }
+
+    static std::optional<GlyphAtlas> read(const std::string& path, uint64_t key) {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) return std::nullopt;
+
+        // Nothing is allocated from the header until the file is known to be exactly that long
+        long length = -1;
+        if (std::fseek(file, 0, SEEK_END) == 0) length = std::ftell(file);
+        std::rewind(file);
+
+        GlyphAtlas atlas;
+        uint32_t header[8];
+        bool valid = std::fread(header, sizeof(header), 1, file) == 1 && header[0] == Magic &&
+                     header[1] == Version && header[4] == static_cast<uint32_t>(key) &&
+                     header[5] == static_cast<uint32_t>(key >> 32) && header[2] > 0 &&
+                     header[2] <= MaxSize;
+        valid = valid && std::fread(&atlas.lineHeight, sizeof(float), 1, file) == 1 &&
+                std::isfinite(atlas.lineHeight);
+
+        size_t bytes = valid ? static_cast<size_t>(header[2]) * header[2] : 0;
+        valid = valid && length >= 0 &&
+                static_cast<uint64_t>(length) ==
+                    sizeof(header) + sizeof(float) + uint64_t{header[3]} * sizeof(Glyph) + bytes;
+
+        if (valid) {
+            atlas.size = header[2];
+            atlas.glyphPixelsPerEm = header[6];
+            atlas.spread = header[7];
+            for (uint32_t i = 0; valid && i < header[3]; i++) {
+                Glyph glyph;
+                valid = std::fread(&glyph, sizeof(Glyph), 1, file) == 1;
+                if (valid) atlas.glyphs[glyph.codepoint] = glyph;
+            }
+            atlas.pixels.resize(bytes);
+            valid = valid && std::fread(atlas.pixels.data(), 1, bytes, file) == bytes;
+        }
+
+        std::fclose(file);
+        if (!valid) return std::nullopt;
+        return atlas;
+    }
+
+    template <typename Field>
+    static void generate(const GlyphBitmap& bitmap, float downscale, int spread, float sourceEm,
+        Field& field) {
+        field.present = true;
+        field.advance = bitmap.advance / sourceEm;
+
+        // Pad the source so the field can fall off outside the outline
+        int pad = static_cast<int>(std::ceil(spread * downscale));
+        int width = bitmap.width + pad * 2;
+        int height = bitmap.height + pad * 2;
+
+        std::vector<bool> inside(width * height, false), outside(width * height, true);
+        for (int y = 0; y < bitmap.height; y++) {
+            for (int x = 0; x < bitmap.width; x++) {
+                bool set = bitmap.coverage[y * bitmap.width + x] >= 128;
+                inside[(y + pad) * width + x + pad] = set;
+                outside[(y + pad) * width + x + pad] = !set;
+            }
+        }
+
+        auto toInside = DistanceField::transform2d(inside, width, height);
+        auto toOutside = DistanceField::transform2d(outside, width, height);
+
+        // Sample the centre of every output pixel, rows flipped to bottom up for the texture
+        field.width = std::max(1, static_cast<int>(std::ceil(width / downscale)));
+        field.height = std::max(1, static_cast<int>(std::ceil(height / downscale)));
+        field.values.resize(field.width * field.height);
+        for (int y = 0; y < field.height; y++) {
+            for (int x = 0; x < field.width; x++) {
+                int sx = std::min(width - 1, static_cast<int>((x + 0.5f) * downscale));
+                int sy = std::min(height - 1, static_cast<int>((y + 0.5f) * downscale));
+                int source = sy * width + sx;
+
+                float distance = inside[source] ? std::sqrt(toOutside[source]) - 0.5f
+                                                : 0.5f - std::sqrt(toInside[source]);
+                float normalized = distance / downscale / spread;
+                float value = std::clamp(128.0f + normalized * 127.0f, 0.0f, 255.0f);
+                int row = field.height - 1 - y;
+                field.values[row * field.width + x] = static_cast<uint8_t>(value);
+            }
+        }
+
+        // The field's quad in ems, the padding extends it past the bitmap on every side
+        float scaledWidth = field.width * downscale;
+        float scaledHeight = field.height * downscale;
+        field.left = (bitmap.bearingX - pad) / sourceEm;
+        field.top = (bitmap.bearingY + pad) / sourceEm;
+        field.right = field.left + scaledWidth / sourceEm;
+        field.bottom = field.top - scaledHeight / sourceEm;
+    }
+};
+
+// One text quad corner, 20 bytes
+struct TextVertex {
+    float x, y;
+    float u, v;
+    uint32_t color;
+};
+
+// Shapes strings into one vertex and index stream so any amount of text is a single draw.
+// Positions are in pixels with y up, pen positions are on the baseline.
+struct TextLayout {
+    const GlyphAtlas* atlas;
+    std::pmr::vector<TextVertex> vertices;
+    std::pmr::vector<uint32_t> indices;
+
+    TextLayout(const GlyphAtlas& atlas,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : atlas(&atlas), vertices(resource), indices(resource) {
+        // Direct lookup for ASCII, the map's nodes never move so the pointers stay valid
+        for (uint32_t c = 0; c < ascii.size(); c++) ascii[c] = atlas.find(c);
+    }
+
+    void clear() {
+        vertices.clear();
+        indices.clear();
+    }
+
+    void reserve(size_t glyphs) {
+        vertices.reserve(glyphs * 4);
+        indices.reserve(glyphs * 6);
+    }
+
+    // Appends ASCII text at the pen position with the given em size in pixels. Newlines return
+    // to the starting column one font line height down. Returns the pen position after the last
+    // glyph.
+    Vector2 append(std::string_view text, Vector2 pen, float size, uint32_t color = 0xffffffff) {
+        // Size for the whole string up front and trim afterwards, so the loop only writes
+        size_t firstVertex = vertices.size();
+        size_t firstIndex = indices.size();
+        vertices.resize(firstVertex + text.size() * 4);
+        indices.resize(firstIndex + text.size() * 6);
+        TextVertex* vertex = vertices.data() + firstVertex;
+        uint32_t* index = indices.data() + firstIndex;
+
+        float startX = pen.x;
+        for (char c : text) {
+            if (c == '\n') {
+                pen.x = startX;
+                pen.y -= atlas->lineHeight * size;
+                continue;
+            }
+
+            auto code = static_cast<unsigned char>(c);
+            auto glyph = code < ascii.size() ? ascii[code] : nullptr;
+            if (!glyph) continue;
+
+            if (c != ' ') {
+                float x0 = pen.x + glyph->left * size, x1 = pen.x + glyph->right * size;
+                float y0 = pen.y + glyph->bottom * size, y1 = pen.y + glyph->top * size;
+
+                uint32_t base = vertex - vertices.data();
+                vertex[0] = {x0, y0, glyph->u0, glyph->v0, color};
+                vertex[1] = {x1, y0, glyph->u1, glyph->v0, color};
+                vertex[2] = {x1, y1, glyph->u1, glyph->v1, color};
+                vertex[3] = {x0, y1, glyph->u0, glyph->v1, color};
+                index[0] = base;
+                index[1] = base + 1;
+                index[2] = base + 2;
+                index[3] = base;
+                index[4] = base + 2;
+                index[5] = base + 3;
+                vertex += 4;
+                index += 6;
+            }
+
+            pen.x += glyph->advance * size;
+        }
+
+        vertices.resize(vertex - vertices.data());
+        indices.resize(index - indices.data());
+        return pen;
+    }
+
+    size_t glyphCount() const { return vertices.size() / 4; }
+
+  private:
+    std::array<const GlyphAtlas::Glyph*, 128> ascii;
+};
+
+// Draws a text layout in one call. The atlas is sampled with linear filtering and the outline is
+// antialiased over one screen pixel using the field's screen space derivative, so text stays sharp
+// at any scale.
+class TextRenderer {
+    std::unique_ptr<ShaderProgram> program;
+    GLuint texture = 0;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+
+    static constexpr const char* vertexSource = R"END(
+        #version 330 core
+        in vec2 aPos;
+        in vec2 aTexCoord;
+        in vec4 aColor;
+
+        out vec2 vTexCoord;
+        out vec4 vColor;
+
+        uniform mat4 uTransform;
+
+        void main() {
+            gl_Position = uTransform * vec4(aPos, 0.0, 1.0);
+            vTexCoord = aTexCoord;
+            vColor = aColor;
+        }
+    )END";
+
+    static constexpr const char* fragmentSource = R"END(
+        #version 330 core
+        in vec2 vTexCoord;
+        in vec4 vColor;
+        uniform sampler2D uAtlas;
+        out vec4 color;
+
+        void main() {
+            float distance = texture(uAtlas, vTexCoord).r;
+            float width = max(fwidth(distance), 1e-4);
+            float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+            color = vec4(vColor.rgb, vColor.a * alpha);
+        }
+    )END";
+
+    TextRenderer() = default;
+
+  public:
+    ~TextRenderer() {
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    TextRenderer(const TextRenderer&) = delete;
+    TextRenderer& operator=(const TextRenderer&) = delete;
+
+    static std::unique_ptr<TextRenderer> create(const GlyphAtlas& atlas) {
+        std::unique_ptr<TextRenderer> renderer(new TextRenderer());
+        renderer->program = ShaderProgram::create(vertexSource, fragmentSource);
+        if (!renderer->program) return nullptr;
+
+        glGenTextures(1, &renderer->texture);
+        glBindTexture(GL_TEXTURE_2D, renderer->texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas.size, atlas.size, 0, GL_RED, GL_UNSIGNED_BYTE,
+            atlas.pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenVertexArrays(1, &renderer->vao);
+        glGenBuffers(1, &renderer->vbo);
+        glGenBuffers(1, &renderer->ebo);
+
+        auto& program = *renderer->program;
+        glBindVertexArray(renderer->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, renderer->vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->ebo);
+
+        auto position = program.getAttributeLocation("aPos");
+        glVertexAttribPointer(position, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex),
+            (void*)offsetof(TextVertex, x));
+        glEnableVertexAttribArray(position);
+
+        auto uv = program.getAttributeLocation("aTexCoord");
+        glVertexAttribPointer(
+            uv, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, u));
+        glEnableVertexAttribArray(uv);
+
+        auto color = program.getAttributeLocation("aColor");
+        glVertexAttribPointer(color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex),
+            (void*)offsetof(TextVertex, color));
+        glEnableVertexAttribArray(color);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        return renderer;
+    }
+
+    // Orphans and refills the buffers, then draws every glyph in the layout with blending on. The
+    // caller's blend state is restored afterwards.
+    void draw(const TextLayout& layout, const Matrix4& transform) {
+        if (layout.indices.empty()) return;
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, layout.vertices.size() * sizeof(TextVertex), nullptr,
+            GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, layout.vertices.size() * sizeof(TextVertex),
+            layout.vertices.data());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, layout.indices.size() * sizeof(uint32_t),
+            layout.indices.data(), GL_STREAM_DRAW);
+
+        program->use();
+        program->setUniform("uTransform", transform);
+        glBindTexture(GL_TEXTURE_2D, texture);
+
+        GLboolean blend = glIsEnabled(GL_BLEND);
+        GLint srcRgb, dstRgb, srcAlpha, dstAlpha;
+        glGetIntegerv(GL_BLEND_SRC_RGB, &srcRgb);
+        glGetIntegerv(GL_BLEND_DST_RGB, &dstRgb);
+        glGetIntegerv(GL_BLEND_SRC_ALPHA, &srcAlpha);
+        glGetIntegerv(GL_BLEND_DST_ALPHA, &dstAlpha);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDrawElements(GL_TRIANGLES, layout.indices.size(), GL_UNSIGNED_INT, 0);
+
+        glBlendFuncSeparate(srcRgb, dstRgb, srcAlpha, dstAlpha);
+        if (!blend) glDisable(GL_BLEND);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
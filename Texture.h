@@ -1,6 +1,10 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <optional>
 #include <vector>
 #include <string>
 #define STB_IMAGE_IMPLEMENTATION
@@ -9,6 +13,65 @@
 
 
 
+// An RGBA image held in cpu memory, rows stored bottom up like an OpenGL texture
+struct HostImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+
+    static std::optional<HostImage> load(const std::string& path) {
+        int width, height, channels;
+        stbi_set_flip_vertically_on_load(true);
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (!data) {
+            std::cout << "Failed to load image: " << path << std::endl;
+            return std::nullopt;
+        }
+
+        HostImage image;
+        image.width = width;
+        image.height = height;
+        image.pixels.assign(data, data + width * height * 4);
+        stbi_image_free(data);
+        return image;
+    }
+
+    // The next mip level down, box filtered and clamping at an odd edge
+    HostImage downsample() const {
+        HostImage level;
+        level.width = std::max(1, width / 2);
+        level.height = std::max(1, height / 2);
+        level.pixels.resize(level.width * level.height * 4);
+
+        auto texel = [&](int x, int y) { return &pixels[(y * width + x) * 4]; };
+        for (int y = 0; y < level.height; y++) {
+            for (int x = 0; x < level.width; x++) {
+                int x1 = std::min(x * 2 + 1, width - 1);
+                int y1 = std::min(y * 2 + 1, height - 1);
+                for (int c = 0; c < 4; c++) {
+                    int sum = texel(x * 2, y * 2)[c] + texel(x1, y * 2)[c] + texel(x * 2, y1)[c] +
+                              texel(x1, y1)[c];
+                    level.pixels[(y * level.width + x) * 4 + c] = (sum + 2) / 4;
+                }
+            }
+        }
+        return level;
+    }
+
+    // Bytes taken on the gpu by the image with a full mip chain
+    size_t byteSizeWithMips() const {
+        size_t bytes = 0;
+        int w = width, h = height;
+        while (true) {
+            bytes += static_cast<size_t>(w) * h * 4;
+            if (w == 1 && h == 1) break;
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+        return bytes;
+    }
+};
+
 // Wraps a texture in OpenGL which is stored on the GPU
 struct DeviceTexture {
     GLuint id;
@@ -45,5 +108,17 @@ struct DeviceTexture {
         // Free the image data from the cpu
         stbi_image_free(data);
     }
+
+    void upload(const HostImage& image) {
+        bind();
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA,
+            GL_UNSIGNED_BYTE, image.pixels.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        unbind();
+    }
 };
 
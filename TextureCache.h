@@ -0,0 +1,378 @@
+#pragma once
+
+#include "Texture.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Creates and destroys the gpu side of cached textures. Split out so the cache's accounting and
+// eviction can run against a stub without a GL context.
+struct TextureBackend {
+    virtual ~TextureBackend() = default;
+    virtual GLuint create(const HostImage& image) = 0;
+    virtual void destroy(GLuint id) = 0;
+
+    // Creates a texture from the second level of id, whose top level is width by height. The
+    // original is left alone. Returns 0 on failure.
+    virtual GLuint reduce(GLuint id, int width, int height) = 0;
+};
+
+// Uploads through DeviceTexture, which generates the full mip chain
+struct GlTextureBackend : TextureBackend {
+    std::unordered_map<GLuint, std::unique_ptr<DeviceTexture>> textures;
+
+    GLuint create(const HostImage& image) override {
+        auto texture = std::make_unique<DeviceTexture>();
+        texture->upload(image);
+        GLuint id = texture->id;
+        textures[id] = std::move(texture);
+        return id;
+    }
+
+    void destroy(GLuint id) override { textures.erase(id); }
+
+    // Reads the already generated second level back rather than reloading and downsampling the
+    // source. The readback waits for the gpu, which budget pressure makes acceptable.
+    GLuint reduce(GLuint id, int width, int height) override {
+        HostImage level;
+        level.width = std::max(1, width / 2);
+        level.height = std::max(1, height / 2);
+        level.pixels.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+        glBindTexture(GL_TEXTURE_2D, id);
+        glGetTexImage(GL_TEXTURE_2D, 1, GL_RGBA, GL_UNSIGNED_BYTE, level.pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return create(level);
+    }
+};
+
+class TextureCache;
+
+// A counted reference to a cached texture. The texture stays registered while any handle to it
+// exists, though it may still be evicted from the gpu and reloaded on its next use. Handles point
+// back at their cache, so every handle has to be destroyed before the cache is.
+class TextureHandle {
+    TextureCache* cache = nullptr;
+    uint32_t index = 0;
+
+    friend class TextureCache;
+
+    TextureHandle(TextureCache* cache, uint32_t index);
+
+  public:
+    TextureHandle() = default;
+    TextureHandle(const TextureHandle& other);
+    TextureHandle(TextureHandle&& other) noexcept;
+    TextureHandle& operator=(TextureHandle other) noexcept;
+    ~TextureHandle();
+
+    explicit operator bool() const { return cache != nullptr; }
+};
+
+// Loads textures at most once per path and per content, keeps an estimate of their video memory
+// and, when over budget, frees memory from the least recently used textures first. Unreferenced
+// textures are dropped entirely, referenced ones first lose their top mip levels and are only
+// evicted once they are down to the minimum size. Evicted textures reload on their next use.
+class TextureCache {
+  public:
+    using Loader = std::function<std::optional<HostImage>(const std::string&)>;
+
+    static constexpr int MinimumDroppedSize = 16;
+
+  private:
+    struct Entry {
+        std::string path;
+        uint64_t hash = 0;
+        int width = 0;
+        int height = 0;
+        GLuint id = 0;
+        bool resident = false;
+        int droppedLevels = 0;
+        size_t bytes = 0;
+        unsigned references = 0;
+        uint64_t lastUsed = 0;
+        std::list<uint32_t>::iterator recency;
+    };
+
+    TextureBackend& backend;
+    Loader loader;
+    size_t budget;
+    size_t used = 0;
+    uint64_t frame = 0;
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeEntries;
+    std::unordered_map<std::string, uint32_t> byPath;
+    std::unordered_map<uint64_t, uint32_t> byHash;
+
+    // Resident entries, most recently used first
+    std::list<uint32_t> recency;
+
+    friend class TextureHandle;
+
+  public:
+    TextureCache(TextureBackend& backend, size_t budget, Loader loader = HostImage::load)
+        : backend(backend), loader(std::move(loader)), budget(budget) {}
+
+    // Handles still alive at this point would release into a destroyed cache
+    ~TextureCache() {
+        for (auto& entry : entries) {
+            assert(entry.references == 0 && "TextureHandle outlived its TextureCache");
+            if (entry.resident) backend.destroy(entry.id);
+        }
+    }
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    size_t bytesUsed() const { return used; }
+
+    size_t bytesBudget() const { return budget; }
+
+    void setBudget(size_t bytes) {
+        budget = bytes;
+        enforceBudget();
+    }
+
+    // Returns a handle to the texture at path, loading it unless the path or identical content is
+    // already cached. An empty handle means the image could not be loaded.
+    TextureHandle acquire(const std::string& path) {
+        auto found = byPath.find(path);
+        if (found != byPath.end()) return TextureHandle(this, found->second);
+
+        auto image = loader(path);
+        if (!image) return {};
+
+        uint64_t hash = contentHash(*image);
+        auto duplicate = byHash.find(hash);
+        if (duplicate != byHash.end()) {
+            byPath[path] = duplicate->second;
+            return TextureHandle(this, duplicate->second);
+        }
+
+        uint32_t index = allocateEntry();
+        auto& entry = entries[index];
+        entry.path = path;
+        entry.hash = hash;
+        entry.width = image->width;
+        entry.height = image->height;
+        byPath[path] = index;
+        byHash[hash] = index;
+
+        makeResident(index, *image);
+        enforceBudget();
+        return TextureHandle(this, index);
+    }
+
+    // Marks the texture as used this frame and returns its gpu id, reloading it if it was evicted
+    // and restoring dropped levels once the budget has room for them
+    GLuint use(const TextureHandle& handle) {
+        auto& entry = entries[handle.index];
+        entry.lastUsed = frame;
+
+        bool restore = entry.droppedLevels > 0 &&
+                       used - entry.bytes + fullSize(entry) <= budget;
+
+        if (!entry.resident || restore) {
+            auto image = loader(entry.path);
+            if (!image) return 0;
+
+            if (entry.resident) evict(handle.index);
+            if (restore) entries[handle.index].droppedLevels = 0;
+            makeResident(handle.index, *image);
+            enforceBudget();
+        } else {
+            recency.splice(recency.begin(), recency, entry.recency);
+        }
+
+        return entries[handle.index].id;
+    }
+
+    void bind(const TextureHandle& handle) { glBindTexture(GL_TEXTURE_2D, use(handle)); }
+
+    // Textures used during the current frame are never evicted, so advance this once per frame
+    void endFrame() { frame++; }
+
+    bool isResident(const TextureHandle& handle) const { return entries[handle.index].resident; }
+
+    int droppedLevels(const TextureHandle& handle) const {
+        return entries[handle.index].droppedLevels;
+    }
+
+    // FNV-1a over the dimensions and pixels
+    static uint64_t contentHash(const HostImage& image) {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&](uint8_t byte) {
+            hash ^= byte;
+            hash *= 1099511628211ull;
+        };
+        for (int shift = 0; shift < 32; shift += 8) {
+            mix(image.width >> shift);
+            mix(image.height >> shift);
+        }
+        for (uint8_t byte : image.pixels) mix(byte);
+        return hash;
+    }
+
+  private:
+    uint32_t allocateEntry() {
+        if (!freeEntries.empty()) {
+            uint32_t index = freeEntries.back();
+            freeEntries.pop_back();
+            entries[index] = Entry();
+            return index;
+        }
+        entries.emplace_back();
+        return entries.size() - 1;
+    }
+
+    void makeResident(uint32_t index, const HostImage& full) {
+        auto& entry = entries[index];
+
+        // Keep whatever levels an earlier eviction had dropped, the budget decides when they return
+        HostImage reduced;
+        const HostImage* image = &full;
+        for (int level = 0; level < entry.droppedLevels; level++) {
+            reduced = image->downsample();
+            image = &reduced;
+        }
+
+        entry.id = backend.create(*image);
+        entry.bytes = image->byteSizeWithMips();
+        entry.resident = true;
+        entry.lastUsed = frame;
+        recency.push_front(index);
+        entry.recency = recency.begin();
+        used += entry.bytes;
+    }
+
+    void evict(uint32_t index) {
+        auto& entry = entries[index];
+        backend.destroy(entry.id);
+        recency.erase(entry.recency);
+        used -= entry.bytes;
+        entry.resident = false;
+        entry.id = 0;
+        entry.bytes = 0;
+    }
+
+    // The texture's top level after dropping the given number of levels
+    static HostImage shape(const Entry& entry, int dropped) {
+        HostImage shape;
+        shape.width = std::max(1, entry.width >> dropped);
+        shape.height = std::max(1, entry.height >> dropped);
+        return shape;
+    }
+
+    static size_t fullSize(const Entry& entry) { return shape(entry, 0).byteSizeWithMips(); }
+
+    // Re-creates the texture one level smaller from its current second level, keeping its place in
+    // the recency order so dropping a level does not count as a use
+    bool dropLevel(uint32_t index) {
+        auto& entry = entries[index];
+        int levels = entry.droppedLevels + 1;
+        if ((entry.width >> levels) < MinimumDroppedSize ||
+            (entry.height >> levels) < MinimumDroppedSize) {
+            return false;
+        }
+
+        auto current = shape(entry, entry.droppedLevels);
+        GLuint id = backend.reduce(entry.id, current.width, current.height);
+        if (!id) return false;
+        backend.destroy(entry.id);
+
+        size_t bytes = shape(entry, levels).byteSizeWithMips();
+        used = used - entry.bytes + bytes;
+        entry.id = id;
+        entry.bytes = bytes;
+        entry.droppedLevels = levels;
+        return true;
+    }
+
+    void release(uint32_t index) {
+        auto& entry = entries[index];
+        if (--entry.references > 0) return;
+
+        // Unreferenced textures stay cached until the budget needs their memory
+        if (!entry.resident) forget(index);
+    }
+
+    void forget(uint32_t index) {
+        auto& entry = entries[index];
+        if (entry.resident) evict(index);
+
+        for (auto it = byPath.begin(); it != byPath.end();) {
+            it = it->second == index ? byPath.erase(it) : std::next(it);
+        }
+        byHash.erase(entry.hash);
+        entry.path.clear();
+        freeEntries.push_back(index);
+    }
+
+    // Each pass walks from the least recently used end, skipping anything the current frame needs,
+    // and takes one level or one texture from every entry it visits
+    void enforceBudget() {
+        bool progress = true;
+        while (used > budget && progress) {
+            progress = false;
+
+            auto it = recency.end();
+            while (used > budget && it != recency.begin()) {
+                --it;
+                uint32_t index = *it;
+                auto& entry = entries[index];
+                if (entry.lastUsed == frame) continue;
+
+                if (entry.references > 0 && dropLevel(index)) {
+                    progress = true;
+                    continue;
+                }
+
+                // Removing the entry invalidates its iterator, resume from its successor
+                auto next = std::next(it);
+                if (entry.references == 0) {
+                    forget(index);
+                } else {
+                    evict(index);
+                }
+                it = next;
+                progress = true;
+            }
+        }
+    }
+};
+
+inline TextureHandle::TextureHandle(TextureCache* cache, uint32_t index)
+    : cache(cache), index(index) {
+    cache->entries[index].references++;
+}
+
+inline TextureHandle::TextureHandle(const TextureHandle& other)
+    : cache(other.cache), index(other.index) {
+    if (cache) cache->entries[index].references++;
+}
+
+inline TextureHandle::TextureHandle(TextureHandle&& other) noexcept
+    : cache(other.cache), index(other.index) {
+    other.cache = nullptr;
+}
+
+inline TextureHandle& TextureHandle::operator=(TextureHandle other) noexcept {
+    std::swap(cache, other.cache);
+    std::swap(index, other.index);
+    return *this;
+}
+
+inline TextureHandle::~TextureHandle() {
+    if (cache) cache->release(index);
+}
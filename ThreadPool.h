@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads draining one shared job queue
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+
+  public:
+    ThreadPool(unsigned count = std::max(1u, std::thread::hardware_concurrency())) {
+        for (unsigned i = 0; i < count; i++) {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static ThreadPool& instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    unsigned size() const { return workers.size(); }
+
+    template <typename F> auto submit(F&& function) -> std::future<decltype(function())> {
+        using Result = decltype(function());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+        auto future = task->get_future();
+        {
+            std::lock_guard lock(mutex);
+            jobs.push([task] { (*task)(); });
+        }
+        available.notify_one();
+        return future;
+    }
+
+    // Splits [0, count) into chunks of at least grain elements and runs body(begin, end) on each.
+    // The calling thread works on chunks too and returns once every chunk has finished. It only
+    // waits for chunks other threads are running, never for helpers still sitting in the queue.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+        if (count == 0) return;
+
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = std::min<size_t>((count + grain - 1) / grain, size() + 1);
+        if (chunks <= 1) {
+            body(0, count);
+            return;
+        }
+
+        // Rounding the chunk size up can leave fewer chunks than asked for, recount from it so
+        // every chunk starts inside the range
+        size_t chunkSize = (count + chunks - 1) / chunks;
+        chunks = (count + chunkSize - 1) / chunkSize;
+
+        // Helpers that start after the caller returned still read the state, so it is shared
+        struct State {
+            const std::function<void(size_t, size_t)>* body;
+            size_t count, chunkSize, chunks;
+            std::atomic<size_t> next = 0;
+            std::atomic<size_t> done = 0;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        auto state = std::make_shared<State>();
+        state->body = &body;
+        state->count = count;
+        state->chunkSize = chunkSize;
+        state->chunks = chunks;
+
+        auto work = [](State& state) {
+            for (size_t chunk = state.next++; chunk < state.chunks; chunk = state.next++) {
+                size_t begin = chunk * state.chunkSize;
+                (*state.body)(begin, std::min(state.count, begin + state.chunkSize));
+                if (++state.done == state.chunks) {
+                    std::lock_guard lock(state.mutex);
+                    state.finished.notify_all();
+                }
+            }
+        };
+
+        {
+            std::lock_guard lock(mutex);
+            for (size_t i = 0; i + 1 < chunks; i++) jobs.push([state, work] { work(*state); });
+        }
+        available.notify_all();
+
+        work(*state);
+        std::unique_lock lock(state->mutex);
+        state->finished.wait(lock, [&] { return state->done == chunks; });
+    }
+
+  private:
+    void run() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock lock(mutex);
+                available.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+};
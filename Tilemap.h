@@ -0,0 +1,310 @@
+#pragma once
+
+#include "Graphics.h"
+#include "Math.h"
+#include "Shader.h"
+#include "Texture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+// A texture holding equally sized tiles in a grid, numbered from 1 left to right and top to
+// bottom. Tile 0 is empty and never drawn.
+struct TileAtlas {
+    int columns;
+    int rows;
+    int width;
+    int height;
+
+    // Texture coordinates of a tile, pulled in by half a texel so filtering never reaches into
+    // the neighbouring tile. Textures are loaded flipped, so the top row has the highest v.
+    void rect(uint16_t tile, float& u0, float& v0, float& u1, float& v1) const {
+        int index = tile - 1;
+        int column = index % columns;
+        int row = index / columns;
+        float insetU = 0.5f / width, insetV = 0.5f / height;
+        u0 = static_cast<float>(column) / columns + insetU;
+        u1 = static_cast<float>(column + 1) / columns - insetU;
+        v0 = 1.0f - static_cast<float>(row + 1) / rows + insetV;
+        v1 = 1.0f - static_cast<float>(row) / rows - insetV;
+    }
+};
+
+// A grid of tile ids split into square chunks. Every change gives its chunk a new version, so
+// renderers can tell which chunks they have to rebuild without the map knowing about them.
+// Versions come from one counter shared by every map, so a version seen for one map never
+// matches a chunk of another.
+class Tilemap {
+    int width;
+    int height;
+    int chunkSize;
+    int chunksX;
+    int chunksY;
+    std::vector<uint16_t> tiles;
+    std::vector<uint64_t> versions;
+
+    static uint64_t nextVersion() {
+        static std::atomic<uint64_t> counter = 0;
+        return ++counter;
+    }
+
+  public:
+    // Chunk geometry uses 16 bit indices, which hold the corners of chunks up to 128 tiles across
+    static constexpr int MaxChunkSize = 128;
+
+    // The chunk size is clamped to [1, MaxChunkSize]
+    Tilemap(int width, int height, int chunkSize = 32)
+        : width(width), height(height), chunkSize(std::clamp(chunkSize, 1, MaxChunkSize)),
+          chunksX((width + this->chunkSize - 1) / this->chunkSize),
+          chunksY((height + this->chunkSize - 1) / this->chunkSize),
+          tiles(static_cast<size_t>(width) * height, 0),
+          versions(chunksX * chunksY, nextVersion()) {}
+
+    int columns() const { return width; }
+
+    int rows() const { return height; }
+
+    int chunkEdge() const { return chunkSize; }
+
+    int chunkColumns() const { return chunksX; }
+
+    int chunkRows() const { return chunksY; }
+
+    uint16_t get(int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height) return 0;
+        return tiles[static_cast<size_t>(y) * width + x];
+    }
+
+    void set(int x, int y, uint16_t tile) {
+        if (x < 0 || y < 0 || x >= width || y >= height) return;
+        auto& slot = tiles[static_cast<size_t>(y) * width + x];
+        if (slot == tile) return;
+        slot = tile;
+        versions[(y / chunkSize) * chunksX + x / chunkSize] = nextVersion();
+    }
+
+    uint64_t version(int chunkX, int chunkY) const { return versions[chunkY * chunksX + chunkX]; }
+};
+
+// One corner of a tile quad, 8 bytes. Positions are in tiles relative to the chunk's corner and
+// texture coordinates are normalized 16 bit.
+struct TileVertex {
+    int16_t x, y;
+    uint16_t u, v;
+};
+
+// Builds and draws static geometry per chunk. A chunk is only rebuilt when its version in the map
+// has changed since it was last built, and only chunks overlapping the view are built or drawn.
+// Versions are unique across maps, so drawing a different map rebuilds rather than reusing.
+class TilemapRenderer {
+    struct Chunk {
+        std::unique_ptr<VertexArray> vao;
+        uint64_t version = 0;
+        size_t bytes = 0;
+    };
+
+    std::unique_ptr<ShaderProgram> program;
+    TileAtlas atlas;
+    std::vector<Chunk> chunks;
+    int chunksX = 0;
+
+    std::vector<TileVertex> vertices;
+    std::vector<uint16_t> indices;
+
+    size_t chunksDrawn = 0;
+    size_t chunksRebuilt = 0;
+
+    static constexpr const char* vertexSource = R"END(
+        #version 330 core
+        in vec2 aPos;
+        in vec2 aTexCoord;
+
+        out vec2 vTexCoord;
+
+        uniform mat4 uTransform;
+        uniform vec3 uChunkOrigin;
+        uniform float uTileSize;
+
+        void main() {
+            vec2 position = (uChunkOrigin.xy + aPos) * uTileSize;
+            gl_Position = uTransform * vec4(position, 0.0, 1.0);
+            vTexCoord = aTexCoord;
+        }
+    )END";
+
+    static constexpr const char* fragmentSource = R"END(
+        #version 330 core
+        in vec2 vTexCoord;
+        uniform sampler2D uTexture;
+        out vec4 color;
+
+        void main() {
+            color = texture(uTexture, vTexCoord);
+            if (color.a < 0.5) discard;
+        }
+    )END";
+
+    TilemapRenderer() = default;
+
+  public:
+    // Tiles are tileSize world units across, the map's corner sits at the origin
+    float tileSize = 1.0f;
+
+    TilemapRenderer(const TilemapRenderer&) = delete;
+    TilemapRenderer& operator=(const TilemapRenderer&) = delete;
+
+    static std::unique_ptr<TilemapRenderer> create(const TileAtlas& atlas, float tileSize = 1.0f) {
+        std::unique_ptr<TilemapRenderer> renderer(new TilemapRenderer());
+        renderer->program = ShaderProgram::create(vertexSource, fragmentSource);
+        if (!renderer->program) return nullptr;
+
+        renderer->atlas = atlas;
+        renderer->tileSize = tileSize;
+        return renderer;
+    }
+
+    // Writes one quad per non-empty tile of the chunk. Indices are 16 bit, which holds the four
+    // corners of every tile in chunks of up to Tilemap::MaxChunkSize tiles across.
+    static void build(const Tilemap& map, int chunkX, int chunkY, const TileAtlas& atlas,
+        std::vector<TileVertex>& vertices, std::vector<uint16_t>& indices) {
+        vertices.clear();
+        indices.clear();
+
+        int size = map.chunkEdge();
+        int left = chunkX * size, bottom = chunkY * size;
+        int right = std::min(left + size, map.columns()), top = std::min(bottom + size, map.rows());
+
+        auto unorm = [](float value) { return static_cast<uint16_t>(value * 65535.0f + 0.5f); };
+
+        for (int y = bottom; y < top; y++) {
+            for (int x = left; x < right; x++) {
+                uint16_t tile = map.get(x, y);
+                if (tile == 0) continue;
+
+                float u0, v0, u1, v1;
+                atlas.rect(tile, u0, v0, u1, v1);
+
+                auto x0 = static_cast<int16_t>(x - left), y0 = static_cast<int16_t>(y - bottom);
+                auto x1 = static_cast<int16_t>(x0 + 1), y1 = static_cast<int16_t>(y0 + 1);
+                auto base = static_cast<uint16_t>(vertices.size());
+                vertices.push_back({x0, y0, unorm(u0), unorm(v0)});
+                vertices.push_back({x1, y0, unorm(u1), unorm(v0)});
+                vertices.push_back({x1, y1, unorm(u1), unorm(v1)});
+                vertices.push_back({x0, y1, unorm(u0), unorm(v1)});
+                for (int corner : {0, 1, 2, 0, 2, 3}) indices.push_back(base + corner);
+            }
+        }
+    }
+
+    // Draws the chunks overlapping the view rectangle, given in world units, rebuilding those
+    // whose tiles changed
+    void draw(const Tilemap& map, float left, float right, float bottom, float top,
+        const Matrix4& transform, DeviceTexture& texture) {
+        if (chunks.size() != static_cast<size_t>(map.chunkColumns() * map.chunkRows()) ||
+            chunksX != map.chunkColumns()) {
+            chunks.clear();
+            chunks.resize(map.chunkColumns() * map.chunkRows());
+            chunksX = map.chunkColumns();
+        }
+
+        chunksDrawn = 0;
+        chunksRebuilt = 0;
+
+        float chunkWorld = map.chunkEdge() * tileSize;
+        int firstX = std::max(0, static_cast<int>(std::floor(left / chunkWorld)));
+        int lastX =
+            std::min(map.chunkColumns() - 1, static_cast<int>(std::floor(right / chunkWorld)));
+        int firstY = std::max(0, static_cast<int>(std::floor(bottom / chunkWorld)));
+        int lastY = std::min(map.chunkRows() - 1, static_cast<int>(std::floor(top / chunkWorld)));
+        if (firstX > lastX || firstY > lastY) return;
+
+        program->use();
+        program->setUniform("uTransform", transform);
+        program->setUniform("uTileSize", tileSize);
+        texture.bind();
+
+        for (int cy = firstY; cy <= lastY; cy++) {
+            for (int cx = firstX; cx <= lastX; cx++) {
+                auto& chunk = chunks[cy * chunksX + cx];
+                if (chunk.version != map.version(cx, cy)) rebuild(map, cx, cy, chunk);
+                if (!chunk.vao) continue;
+
+                float origin = static_cast<float>(map.chunkEdge());
+                program->setUniform("uChunkOrigin", Vector3(cx * origin, cy * origin, 0));
+                glBindVertexArray(chunk.vao->id);
+                glDrawElements(GL_TRIANGLES, chunk.vao->indexCount, GL_UNSIGNED_SHORT, 0);
+                chunksDrawn++;
+            }
+        }
+
+        glBindVertexArray(0);
+        texture.unbind();
+    }
+
+    size_t drawnLastFrame() const { return chunksDrawn; }
+
+    size_t rebuiltLastFrame() const { return chunksRebuilt; }
+
+    // Video memory held by every built chunk
+    size_t bytesUsed() const {
+        size_t total = 0;
+        for (auto& chunk : chunks) total += chunk.bytes;
+        return total;
+    }
+
+  private:
+    void rebuild(const Tilemap& map, int cx, int cy, Chunk& chunk) {
+        chunk.version = map.version(cx, cy);
+        chunksRebuilt++;
+
+        build(map, cx, cy, atlas, vertices, indices);
+        if (indices.empty()) {
+            chunk.vao.reset();
+            chunk.bytes = 0;
+            return;
+        }
+
+        if (!chunk.vao) {
+            chunk.vao = std::make_unique<VertexArray>();
+            auto vbo = std::make_unique<VertexBuffer>();
+            auto ebo = std::make_unique<VertexBuffer>();
+            ebo->target = GL_ELEMENT_ARRAY_BUFFER;
+
+            glBindVertexArray(chunk.vao->id);
+            vbo->bind();
+            ebo->bind();
+
+            auto position = program->getAttributeLocation("aPos");
+            glVertexAttribPointer(position, 2, GL_SHORT, GL_FALSE, sizeof(TileVertex),
+                (void*)offsetof(TileVertex, x));
+            glEnableVertexAttribArray(position);
+            auto uv = program->getAttributeLocation("aTexCoord");
+            glVertexAttribPointer(uv, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(TileVertex),
+                (void*)offsetof(TileVertex, u));
+            glEnableVertexAttribArray(uv);
+
+            chunk.vao->addBuffer(std::move(vbo));
+            chunk.vao->addBuffer(std::move(ebo));
+        } else {
+            glBindVertexArray(chunk.vao->id);
+        }
+
+        // The vertex array remembers the element buffer, the array buffer has to be bound again
+        chunk.vao->buffers[0]->bind();
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TileVertex), vertices.data(),
+            GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(),
+            GL_STATIC_DRAW);
+        chunk.vao->indexCount = indices.size();
+        chunk.bytes = vertices.size() * sizeof(TileVertex) + indices.size() * sizeof(uint16_t);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "Math.h"
+#include "StreamBuffer.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+
+#include <glad/glad.h>
+
+namespace Std140 {
+
+constexpr size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Base alignment, size and packing of a single member under the std140 rules
+template <typename T> struct Traits;
+
+template <> struct Traits<float> {
+    static constexpr size_t alignment = 4;
+    static constexpr size_t size = 4;
+    static void write(uint8_t* dst, const float& value) { std::memcpy(dst, &value, 4); }
+};
+
+template <> struct Traits<int32_t> {
+    static constexpr size_t alignment = 4;
+    static constexpr size_t size = 4;
+    static void write(uint8_t* dst, const int32_t& value) { std::memcpy(dst, &value, 4); }
+};
+
+template <> struct Traits<uint32_t> {
+    static constexpr size_t alignment = 4;
+    static constexpr size_t size = 4;
+    static void write(uint8_t* dst, const uint32_t& value) { std::memcpy(dst, &value, 4); }
+};
+
+template <> struct Traits<Vector2> {
+    static constexpr size_t alignment = 8;
+    static constexpr size_t size = 8;
+    static void write(uint8_t* dst, const Vector2& value) {
+        float data[2] = {value.x, value.y};
+        std::memcpy(dst, data, sizeof(data));
+    }
+};
+
+// A vec3 is aligned like a vec4 but only occupies three floats, a following scalar packs in after it
+template <> struct Traits<Vector3> {
+    static constexpr size_t alignment = 16;
+    static constexpr size_t size = 12;
+    static void write(uint8_t* dst, const Vector3& value) {
+        float data[3] = {value.x, value.y, value.z};
+        std::memcpy(dst, data, sizeof(data));
+    }
+};
+
+template <> struct Traits<Vector4> {
+    static constexpr size_t alignment = 16;
+    static constexpr size_t size = 16;
+    static void write(uint8_t* dst, const Vector4& value) {
+        float data[4] = {value.x, value.y, value.z, value.w};
+        std::memcpy(dst, data, sizeof(data));
+    }
+};
+
+// Matrix4 stores its rows contiguously (setUniform uploads it transposed), a std140 mat4 is four
+// column vectors, so the matrix is transposed on the way in
+template <> struct Traits<Matrix4> {
+    static constexpr size_t alignment = 16;
+    static constexpr size_t size = 64;
+    static void write(uint8_t* dst, const Matrix4& value) {
+        float data[16];
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                data[column * 4 + row] = value.data[row * 4 + column];
+            }
+        }
+        std::memcpy(dst, data, sizeof(data));
+    }
+};
+
+// Every array element is padded out to a multiple of a vec4
+template <typename T, size_t N> struct Traits<std::array<T, N>> {
+    static constexpr size_t stride = alignUp(Traits<T>::size, 16);
+    static constexpr size_t alignment = 16;
+    static constexpr size_t size = stride * N;
+    static void write(uint8_t* dst, const std::array<T, N>& value) {
+        for (size_t i = 0; i < N; i++) {
+            Traits<T>::write(dst + i * stride, value[i]);
+        }
+    }
+};
+
+// Names one member of the described struct
+template <auto Member> struct Field;
+
+template <typename Owner, typename T, T Owner::*Member> struct Field<Member> {
+    using Type = T;
+    static const T& get(const Owner& owner) { return owner.*Member; }
+};
+
+} // namespace Std140
+
+// Describes the std140 layout of a C++ struct from an ordered list of its members. Offsets and the
+// padded block size are computed at compile time, so layouts can be checked with static_assert.
+//
+//   struct Frame { Matrix4 projection; Vector3 light; float time; };
+//   using FrameBlock = UniformBlock<Frame, &Frame::projection, &Frame::light, &Frame::time>;
+//   static_assert(FrameBlock::offset<2>() == 76);
+template <typename T, auto... Members> struct UniformBlock {
+    using Fields = std::tuple<Std140::Field<Members>...>;
+
+    static constexpr size_t count = sizeof...(Members);
+
+    static constexpr std::array<size_t, count> computeOffsets() {
+        std::array<size_t, count> offsets = {};
+        constexpr size_t alignments[] = {
+            Std140::Traits<typename Std140::Field<Members>::Type>::alignment...};
+        constexpr size_t sizes[] = {Std140::Traits<typename Std140::Field<Members>::Type>::size...};
+
+        size_t cursor = 0;
+        for (size_t i = 0; i < count; i++) {
+            cursor = Std140::alignUp(cursor, alignments[i]);
+            offsets[i] = cursor;
+            cursor += sizes[i];
+        }
+        return offsets;
+    }
+
+    static constexpr std::array<size_t, count> offsets = computeOffsets();
+
+    template <size_t I> static constexpr size_t offset() { return offsets[I]; }
+
+    // The block as a whole is rounded up to the alignment of a vec4
+    static constexpr size_t size() {
+        constexpr size_t sizes[] = {Std140::Traits<typename Std140::Field<Members>::Type>::size...};
+        return Std140::alignUp(offsets[count - 1] + sizes[count - 1], 16);
+    }
+
+    static void write(void* destination, const T& value) {
+        auto dst = static_cast<uint8_t*>(destination);
+        std::memset(dst, 0, size());
+        writeFields(dst, value, std::make_index_sequence<count>());
+    }
+
+  private:
+    template <size_t... I>
+    static void writeFields(uint8_t* dst, const T& value, std::index_sequence<I...>) {
+        (Std140::Traits<typename std::tuple_element_t<I, Fields>::Type>::write(
+             dst + offsets[I], std::tuple_element_t<I, Fields>::get(value)),
+            ...);
+    }
+};
+
+// Wraps an OpenGL Uniform Buffer holding a single block
+struct UniformBuffer {
+    GLuint id;
+    size_t size;
+
+    UniformBuffer(size_t size) : size(size) {
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    ~UniformBuffer() { glDeleteBuffers(1, &id); }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    template <typename Block, typename T> void update(const T& value) {
+        static_assert(Block::size() > 0);
+        uint8_t data[Block::size()];
+        Block::write(data, value);
+
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, Block::size(), data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void bind(unsigned binding) { glBindBufferBase(GL_UNIFORM_BUFFER, binding, id); }
+};
+
+namespace UniformStream {
+
+// Packs a block into the current frame of a stream buffer and binds that range. Returns false if
+// the frame's region is exhausted. On the orphaning path the write only reaches the gpu once the
+// stream is committed, so stream.commit() has to come between bind and the draws reading it.
+template <typename Block, typename T>
+bool bind(StreamBuffer& stream, unsigned binding, const T& value) {
+    static const GLint alignment = [] {
+        GLint value = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &value);
+        return value;
+    }();
+
+    auto allocation = stream.allocate(Block::size(), alignment);
+    if (!allocation) return false;
+
+    Block::write(allocation->pointer, value);
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, stream.id, allocation->offset, allocation->size);
+    return true;
+}
+
+} // namespace UniformStream
@@ -0,0 +1,105 @@
+#include "../AnimationTrack.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Compresses 200 ten second clips of smooth curves baked at 60 Hz, then reports the size ratio,
+// the largest sampled error and the cost of sequential sampling against a binary search over the
+// raw keys
+using Clock = std::chrono::steady_clock;
+
+// Keeps the sampled values alive so the timed loops are not optimised away
+static volatile float sink;
+
+static double nanoseconds(Clock::time_point start, size_t samples) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / samples;
+}
+
+// Binary search and interpolation over one raw channel, what playback does without compression
+static float rawSample(const std::vector<Keyframe>& keys, float time) {
+    auto next = std::upper_bound(keys.begin(), keys.end(), time,
+        [](float time, const Keyframe& key) { return time < key.time; });
+    if (next == keys.end()) return keys.back().value;
+    if (next == keys.begin()) return next->value;
+
+    auto previous = next - 1;
+    float alpha = (time - previous->time) / (next->time - previous->time);
+    return previous->value + (next->value - previous->value) * alpha;
+}
+
+int main() {
+    const float tolerance = 1e-3f;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> uniform(-1, 1);
+
+    std::vector<RawTrack> raws;
+    std::vector<CompressedTrack> tracks;
+    size_t rawBytes = 0, compressedBytes = 0;
+    for (int clip = 0; clip < 200; clip++) {
+        float amplitude[3], frequency[3];
+        for (int i = 0; i < 3; i++) {
+            amplitude[i] = uniform(random);
+            frequency[i] = 0.2f + std::fabs(uniform(random));
+        }
+
+        RawTrack raw;
+        for (int i = 0; i <= 600; i++) {
+            float t = i / 60.0f;
+            Transform transform;
+            transform.translation = {amplitude[0] * std::sin(frequency[0] * t),
+                amplitude[1] * std::sin(frequency[1] * t), 0};
+            transform.scale = {1, 1 + 0.2f * std::sin(frequency[2] * t), 1};
+            transform.rotation = amplitude[2] * t;
+            raw.add(t, transform);
+        }
+
+        tracks.push_back(CompressedTrack::compress(raw, tolerance));
+        rawBytes += raw.byteSize();
+        compressedBytes += tracks.back().byteSize();
+        raws.push_back(std::move(raw));
+    }
+
+    float worst = 0;
+    for (size_t clip = 0; clip < tracks.size(); clip++) {
+        TrackCursor cursor(tracks[clip]);
+        auto& channels = raws[clip].channels;
+        for (int i = 0; i <= 6000; i++) {
+            float t = i / 600.0f;
+            Transform transform = cursor.sample(Seconds(t));
+            worst = std::max({worst,
+                std::fabs(transform.translation.x - rawSample(channels[0], t)),
+                std::fabs(transform.scale.y - rawSample(channels[4], t)),
+                std::fabs(transform.rotation - rawSample(channels[6], t))});
+        }
+    }
+
+    // Playback at 240 Hz, the compressed side through a cursor and the raw side by searching
+    const size_t samples = tracks.size() * 2400;
+    float sum = 0;
+
+    auto start = Clock::now();
+    for (auto& track : tracks) {
+        TrackCursor cursor(track);
+        for (int i = 0; i < 2400; i++) sum += cursor.sample(Seconds(i / 240.0f)).translation.x;
+    }
+    double compressed = nanoseconds(start, samples);
+
+    start = Clock::now();
+    for (auto& raw : raws) {
+        for (int i = 0; i < 2400; i++) {
+            for (auto& channel : raw.channels) sum += rawSample(channel, i / 240.0f);
+        }
+    }
+    double uncompressed = nanoseconds(start, samples);
+    sink = sum;
+
+    std::cout << "ratio " << static_cast<double>(rawBytes) / compressedBytes << " (" << rawBytes
+              << " to " << compressedBytes << " bytes), max error " << worst << " at tolerance "
+              << tolerance << std::endl;
+    std::cout << "sample " << compressed << " ns compressed, " << uncompressed << " ns raw"
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "Check.h"
+
+#include "../AnimationTrack.h"
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+// Ten seconds of one curve on translation x at 60 Hz, every other channel constant
+static RawTrack curve(const std::function<float(float)>& f) {
+    RawTrack track;
+    for (int i = 0; i <= 600; i++) {
+        float t = i / 60.0f;
+        Transform transform;
+        transform.translation = {f(t), 0, 0};
+        transform.scale = {1, 1, 1};
+        track.add(t, transform);
+    }
+    return track;
+}
+
+// The raw curve between its keys, the reference the compressed samples are held to
+static float rawAt(const std::vector<Keyframe>& keys, float time) {
+    if (time <= keys.front().time) return keys.front().value;
+    for (size_t i = 1; i < keys.size(); i++) {
+        if (keys[i].time < time) continue;
+        float alpha = (time - keys[i - 1].time) / (keys[i].time - keys[i - 1].time);
+        return keys[i - 1].value + (keys[i].value - keys[i - 1].value) * alpha;
+    }
+    return keys.back().value;
+}
+
+// Samples ten times per raw frame, so points between keys are covered as well
+static float maxError(const RawTrack& raw, const CompressedTrack& track) {
+    TrackCursor cursor(track);
+    float worst = 0;
+    for (int i = 0; i <= 6000; i++) {
+        float t = i / 600.0f;
+        float value = cursor.sample(Seconds(t)).translation.x;
+        worst = std::max(worst, std::fabs(value - rawAt(raw.channels[0], t)));
+    }
+    return worst;
+}
+
+static size_t keyCount(const CompressedTrack& track) { return track.ranges[0].count; }
+
+static void staysWithinTolerance() {
+    const float tolerance = 1e-3f;
+    const std::pair<const char*, std::function<float(float)>> curves[] = {
+        {"5 sin(3t)", [](float t) { return 5 * std::sin(3 * t); }},
+        {"t squared", [](float t) { return t * t; }},
+        {"cos(7t)", [](float t) { return std::cos(7 * t); }},
+        {"steep ramp", [](float t) { return 300 * t; }},
+        {"wide range", [](float t) { return 1000 * std::sin(t); }},
+    };
+
+    for (auto& [name, f] : curves) {
+        auto raw = curve(f);
+        auto track = CompressedTrack::compress(raw, tolerance);
+        float error = maxError(raw, track);
+        if (error > tolerance || keyCount(track) >= 601) {
+            std::cout << name << ": error " << error << ", " << keyCount(track) << " keys"
+                      << std::endl;
+        }
+        check(error <= tolerance, "sampled error stays within tolerance");
+        check(keyCount(track) < 601, "keys are dropped");
+    }
+
+    auto ramp = CompressedTrack::compress(curve([](float t) { return 300 * t; }), tolerance);
+    check(keyCount(ramp) == 2, "a straight line keeps only its ends");
+
+    auto wide = CompressedTrack::compress(curve([](float t) { return 1000 * std::sin(t); }), 1e-3f);
+    check(wide.ranges[0].wide, "a range too wide for 16 bit steps keeps floats");
+    check(!ramp.ranges[1].wide && ramp.ranges[1].count == 2, "a constant channel keeps two keys");
+}
+
+static void timesAreExact() {
+    auto raw = curve([](float t) { return std::sin(t); });
+    auto track = CompressedTrack::compress(raw, 1e-3f);
+    for (uint32_t key = 0; key < keyCount(track); key++) {
+        float time = track.time(key);
+        check(std::fabs(time * 60.0f - std::round(time * 60.0f)) < 1e-3f, "key times sit on frames");
+    }
+}
+
+static void zeroDurationSamples() {
+    Transform start, end;
+    start.translation = {0, 0, 0};
+    end.translation = {2, 0, 0};
+    auto raw = RawTrack::sample(AnimationFrame(start, end, Easing::linear), Seconds(0.0f), 60);
+    auto track = CompressedTrack::compress(raw, 1e-3f);
+    TrackCursor cursor(track);
+    float x = cursor.sample(Seconds(0.0f)).translation.x;
+    check(!std::isnan(x) && std::fabs(x - 2) < 1e-3f, "a zero duration bakes the end pose");
+}
+
+static void seeksBackwards() {
+    auto raw = curve([](float t) { return t; });
+    auto track = CompressedTrack::compress(raw, 1e-3f);
+    TrackCursor cursor(track);
+    cursor.sample(Seconds(9.0f));
+    float x = cursor.sample(Seconds(1.0f)).translation.x;
+    check(std::fabs(x - 1) < 1e-3f, "sampling an earlier time restarts the cursor");
+}
+
+int main() {
+    staysWithinTolerance();
+    timesAreExact();
+    zeroDurationSamples();
+    seeksBackwards();
+
+    return report("AnimationTrack");
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <iostream>
+
+// The cpu tests' whole harness: a failed check is printed and counted, and report turns the count
+// into main's exit code
+inline int failures = 0;
+
+inline void check(bool condition, const char* what) {
+    if (condition) return;
+    std::cout << "FAILED: " << what << std::endl;
+    failures++;
+}
+
+inline int report(const char* suite) {
+    if (failures > 0) return 1;
+    std::cout << suite << " tests passed" << std::endl;
+    return 0;
+}
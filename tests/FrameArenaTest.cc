@@ -0,0 +1,107 @@
+#include "Check.h"
+
+#include "../FrameArena.h"
+#include "../Graphics.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+
+// Every global new in this program is counted, so a steady state frame can be shown to make no
+// heap allocation of any kind, not just none through the arenas
+static std::atomic<size_t> heapAllocations = 0;
+
+void* operator new(size_t size) {
+    heapAllocations++;
+    if (void* pointer = std::malloc(size ? size : 1)) return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+
+// A frame's worth of transient work: a few hundred small builders and a scratch matrix list
+static float frame(int index) {
+    float sum = 0;
+    for (int b = 0; b < 200; b++) {
+        VertexArrayBuilder builder(Frame::resource());
+        for (int v = 0; v < 64; v++) {
+            builder.vertex(v, b, index, 1).uv(0, 1).normal(0, 0, 1).end();
+            builder.index(v);
+        }
+        sum += builder.data.back();
+    }
+
+    std::pmr::vector<Matrix4> transforms(Frame::resource());
+    for (int i = 0; i < 500; i++) transforms.push_back(Matrix4::translate(i, 0, 0));
+    return sum + transforms.back().data[3];
+}
+
+static void steadyStateDoesNotAllocate() {
+    auto& allocator = FrameAllocator::instance();
+
+    for (int i = 0; i < 3; i++) {
+        frame(i);
+        allocator.endFrame();
+    }
+
+    size_t growths = allocator.arenaGrowths();
+    size_t heap = heapAllocations;
+    float sum = 0;
+    for (int i = 0; i < 100; i++) {
+        sum += frame(i);
+        allocator.endFrame();
+    }
+
+    check(sum != 0, "frames did their work");
+    check(allocator.arenaGrowths() == growths, "no arena grows after warm up");
+    check(heapAllocations == heap, "no heap allocation at all after warm up");
+}
+
+static void markAndRewind() {
+    FrameArena arena(256);
+    auto start = arena.mark();
+    void* first = arena.allocate(100, 16);
+    auto middle = arena.mark();
+    void* second = arena.allocate(100, 16);
+    check(static_cast<char*>(second) >= static_cast<char*>(first) + 100, "allocations bump");
+    check(arena.used() >= 200, "used counts both allocations");
+
+    arena.rewind(middle);
+    check(arena.used() < 200 && arena.used() >= 100, "rewind returns to the marker");
+    arena.rewind(start);
+    check(arena.used() == 0, "rewinding to the start frees everything");
+
+    void* large = arena.allocate(1000, 16);
+    check(large && arena.reserved() >= 1000, "an oversized request gets a block of its own");
+    arena.reset();
+    check(arena.used() == 0 && arena.peakUsage() >= 1000, "reset keeps the peak");
+}
+
+static void exitedThreadsAreReleased() {
+    auto& allocator = FrameAllocator::instance();
+    size_t before = allocator.arenaCount();
+
+    size_t during = 0;
+    std::thread worker([&] {
+        check(Frame::resource()->allocate(4096, 16) != nullptr, "a worker allocates");
+        during = allocator.arenaCount();
+    });
+    worker.join();
+    check(during == before + 1, "a new thread gets an arena of its own");
+    check(allocator.arenaCount() == before, "an exited thread's arena is retired");
+
+    allocator.endFrame();
+    check(allocator.arenaCount() == before, "retired arenas are not reused or leaked");
+}
+
+int main() {
+    steadyStateDoesNotAllocate();
+    markAndRewind();
+    exitedThreadsAreReleased();
+
+    return report("FrameArena");
+}
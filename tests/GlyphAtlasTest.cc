@@ -0,0 +1,78 @@
+#include "Check.h"
+
+#include "../Text.h"
+
+#include <cstdio>
+#include <iostream>
+
+// The builtin font under a different version, as if its glyphs had been edited
+struct EditedFont : BuiltinFont {
+    uint64_t version() const override { return BuiltinFont::version() + 1; }
+};
+
+static std::vector<uint8_t> contents(const std::string& path) {
+    std::vector<uint8_t> bytes;
+    if (FILE* file = std::fopen(path.c_str(), "rb")) {
+        int c;
+        while ((c = std::fgetc(file)) != EOF) bytes.push_back(c);
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+static void overwrite(const std::string& path, const std::vector<uint8_t>& bytes) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    std::fwrite(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+}
+
+static void usesTheSourceLineHeight() {
+    BuiltinFont font;
+    auto atlas = GlyphAtlas::build(font, 'A', 'B', 16, 4, 128);
+    check(atlas && atlas->lineHeight == font.lineHeight() / font.pixelsPerEm(),
+        "the atlas keeps the source's line height in ems");
+
+    TextLayout layout(*atlas);
+    auto pen = layout.append("A\nB", {0, 0}, 10);
+    check(pen.y == -atlas->lineHeight * 10, "a newline moves down one line height");
+}
+
+static void cacheRejectsBadFiles() {
+    const std::string path = "glyph_atlas_test.sdf";
+    BuiltinFont font;
+    std::remove(path.c_str());
+
+    auto built = GlyphAtlas::loadOrBuild(path, font, 'A', 'C', 16, 4, 128);
+    auto file = contents(path);
+    check(built && !file.empty(), "a built atlas is cached");
+
+    auto loaded = GlyphAtlas::loadOrBuild(path, font, 'A', 'C', 16, 4, 128);
+    check(loaded && loaded->pixels == built->pixels && loaded->glyphs.size() == 3,
+        "the cache reads back what was built");
+
+    // A header claiming a huge atlas must not be trusted, the cache is rebuilt instead
+    auto corrupt = file;
+    corrupt[8] = corrupt[9] = corrupt[10] = 0xff;
+    overwrite(path, corrupt);
+    loaded = GlyphAtlas::loadOrBuild(path, font, 'A', 'C', 16, 4, 128);
+    check(loaded && loaded->size == 128, "an oversized header is rejected");
+    check(contents(path) == file, "the rejected file is rewritten");
+
+    overwrite(path, std::vector<uint8_t>(file.begin(), file.end() - 1));
+    loaded = GlyphAtlas::loadOrBuild(path, font, 'A', 'C', 16, 4, 128);
+    check(loaded && contents(path) == file, "a truncated file is rebuilt");
+
+    EditedFont edited;
+    GlyphAtlas::loadOrBuild(path, edited, 'A', 'C', 16, 4, 128);
+    check(contents(path) != file, "a new source version misses the cache");
+
+    std::remove(path.c_str());
+    check(!built->write("missing-directory/atlas.sdf", 0), "a failed write is reported");
+}
+
+int main() {
+    usesTheSourceLineHeight();
+    cacheRejectsBadFiles();
+
+    return report("GlyphAtlas");
+}
@@ -0,0 +1,41 @@
+#include "Check.h"
+
+#include "../Particles.h"
+
+#include <iostream>
+#include <vector>
+
+// Colours on and between every byte step, including the exact halves where rounding modes differ
+static void packingRoundsLikeTheScalarPath() {
+    ParticleEmitter emitter(2048);
+    for (int step = 0; step < 2048; step++) {
+        float value = step / 2047.0f * 1.2f - 0.1f;
+        if (step % 2 == 0) value = (step / 2 % 256 + 0.5f) / 255.0f;
+        emitter.settings.startColor = Vector4(value, 1 - value, value * 0.5f, value);
+        emitter.emit(1);
+    }
+
+    std::vector<float> centers(emitter.size() * 4);
+    std::vector<uint32_t> wide(emitter.size()), scalar(emitter.size());
+    ParticleRenderer::pack(emitter, 0, emitter.size(), centers.data(), wide.data());
+    for (size_t i = 0; i < emitter.size(); i++) {
+        ParticleRenderer::pack(emitter, i, i + 1, centers.data(), scalar.data());
+    }
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < emitter.size(); i++) mismatches += wide[i] != scalar[i];
+    check(mismatches == 0, "four wide and one at a time packing agree");
+}
+
+static void capacityIsRoundedToWholeQuads() {
+    ParticleEmitter emitter(5);
+    check(emitter.maxSize() == 8, "capacity rounds up to a multiple of four");
+    check(emitter.emit(10) == 8 && emitter.size() == 8, "emit stops at capacity");
+}
+
+int main() {
+    packingRoundsLikeTheScalarPath();
+    capacityIsRoundedToWholeQuads();
+
+    return report("Particles");
+}
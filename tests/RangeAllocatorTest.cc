@@ -0,0 +1,74 @@
+#include "Check.h"
+
+#include "../MeshPool.h"
+
+#include <iostream>
+
+static void firstFitAndCoalescing() {
+    RangeAllocator allocator(100);
+    auto a = allocator.allocate(30);
+    auto b = allocator.allocate(30);
+    auto c = allocator.allocate(30);
+    check(a == 0u && b == 30u && c == 60u, "allocations are placed first-fit");
+    check(!allocator.allocate(20), "allocation larger than the remaining space fails");
+
+    allocator.release(*a);
+    allocator.release(*b);
+    check(allocator.freeList.size() == 2, "adjacent releases coalesce");
+    check(allocator.largestFree() == 60, "coalesced hole spans both ranges");
+    check(allocator.allocate(50) == 0u, "coalesced hole is reused");
+}
+
+// Holes of 20 and 20 with 60 live: 40 free in total, but no block of 30
+static RangeAllocator fragmented() {
+    RangeAllocator allocator(100);
+    uint32_t offsets[5];
+    for (auto& offset : offsets) offset = *allocator.allocate(20);
+    allocator.release(offsets[1]);
+    allocator.release(offsets[3]);
+    return allocator;
+}
+
+static void growthNeedsContiguousSpace() {
+    auto allocator = fragmented();
+    check(allocator.used == 60 && allocator.tailFree() == 0, "fragmented setup");
+    check(!allocator.allocate(30), "no contiguous block of 30 before growing");
+
+    uint32_t grown = allocator.grownCapacity(30);
+    check(grown == 200, "grows past the free holes to a doubling with a tail that fits");
+    allocator.grow(grown);
+    check(allocator.allocate(30) == 100u, "allocation succeeds in the grown tail");
+
+    RangeAllocator tail(100);
+    tail.allocate(90);
+    check(tail.tailFree() == 10, "tail free range is measured");
+    check(tail.grownCapacity(10) == 100, "no growth when the tail already fits");
+    check(tail.grownCapacity(11) == 200, "the existing tail counts towards growth");
+
+    RangeAllocator empty;
+    check(empty.grownCapacity(5) == 8, "empty allocator doubles from one");
+
+    RangeAllocator full(3u << 30);
+    full.allocate(3u << 30);
+    check(full.grownCapacity(2u << 30) == UINT32_MAX, "growth saturates instead of overflowing");
+}
+
+static void defragmentCompacts() {
+    auto allocator = fragmented();
+    auto relocations = allocator.defragment();
+
+    check(relocations.size() == 2, "only ranges above a hole move");
+    check(relocations[0].from == 40 && relocations[0].to == 20, "first relocation slides down");
+    check(relocations[1].from == 80 && relocations[1].to == 40, "second relocation slides down");
+    check(allocator.fragmentation() == 0.0f, "no fragmentation after compaction");
+    check(allocator.tailFree() == 40 && allocator.largestFree() == 40, "free space is one tail");
+    check(allocator.allocate(20) == 60u, "compacted tail is allocatable");
+}
+
+int main() {
+    firstFitAndCoalescing();
+    growthNeedsContiguousSpace();
+    defragmentCompacts();
+
+    return report("RangeAllocator");
+}
@@ -0,0 +1,64 @@
+#include "Check.h"
+
+#include "../Skeleton.h"
+
+#include <cmath>
+#include <iostream>
+
+// A root joint and one child, the child carrying every vertex of a single triangle
+static Skeleton twoJoints() {
+    Skeleton skeleton;
+    auto root = skeleton.addJoint(Skeleton::Root, Matrix4::identity());
+    skeleton.addJoint(root, Matrix4::identity());
+    return skeleton;
+}
+
+static VertexArrayBuilder triangle() {
+    VertexArrayBuilder builder;
+    builder.vertex(0, 0, 0, 1).uv(0, 0).normal(0, 0, 1).end();
+    builder.vertex(1, 0, 0, 1).uv(1, 0).normal(0, 0, 1).end();
+    builder.vertex(0, 1, 0, 1).uv(0, 1).normal(0, 0, 1).end();
+    builder.index(0);
+    builder.index(1);
+    builder.index(2);
+    return builder;
+}
+
+static void rejectsJointsOutsideTheSkeleton() {
+    auto skeleton = twoJoints();
+    std::vector<SkinWeights> weights(3, SkinWeights{{1, 0, 0, 0}, {1, 0, 0, 0}});
+    check(SkinnedMesh::create(triangle(), weights, skeleton).vertexCount() == 3,
+        "joints within the skeleton are accepted");
+
+    weights[2].joints[3] = 2;
+    check(SkinnedMesh::create(triangle(), weights, skeleton).vertexCount() == 0,
+        "a joint past the skeleton is refused, even at zero weight");
+
+    check(SkinnedMesh::create(triangle(), {weights[0]}, skeleton).vertexCount() == 0,
+        "a weight count mismatch is refused");
+}
+
+static void skinsWithThePose() {
+    auto skeleton = twoJoints();
+    std::vector<SkinWeights> weights(3, SkinWeights{{1, 0, 0, 0}, {1, 0, 0, 0}});
+    auto mesh = SkinnedMesh::create(triangle(), weights, skeleton);
+    check(mesh.jointCount == 2, "the mesh remembers its skeleton's size");
+
+    Pose pose(skeleton);
+    pose.local[1].translation = {2, 3, 0};
+    pose.evaluate(skeleton);
+
+    std::vector<Skinning::JointColumns> palette;
+    Skinning::preparePalette(pose, palette);
+    std::vector<VertexArrayBuilder::Component> output(mesh.vertexCount());
+    Skinning::skin(mesh, palette, 0, mesh.vertexCount(), output.data());
+    check(std::fabs(output[1].x - 3) < 1e-5f && std::fabs(output[1].y - 3) < 1e-5f,
+        "vertices follow their joint");
+}
+
+int main() {
+    rejectsJointsOutsideTheSkeleton();
+    skinsWithThePose();
+
+    return report("Skinning");
+}
@@ -0,0 +1,101 @@
+#include "Check.h"
+
+#include "../SoftwareRenderer.h"
+
+#include <cstring>
+#include <iostream>
+
+// A smooth gradient, so filtering error near texel centres stays within a step or two
+static HostImage gradient(int size) {
+    HostImage image;
+    image.width = image.height = size;
+    image.pixels.resize(size * size * 4);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            uint8_t* texel = &image.pixels[(y * size + x) * 4];
+            texel[0] = x * 255 / (size - 1);
+            texel[1] = y * 255 / (size - 1);
+            texel[2] = 128;
+            texel[3] = 255;
+        }
+    }
+    return image;
+}
+
+// Covers the whole target with texture coordinates running from 0 to 1
+static VertexArrayBuilder fullscreenQuad() {
+    VertexArrayBuilder builder;
+    builder.vertex(-1, -1, 0, 1).uv(0, 0).normal(0, 0, 1).end();
+    builder.vertex(1, -1, 0, 1).uv(1, 0).normal(0, 0, 1).end();
+    builder.vertex(-1, 1, 0, 1).uv(0, 1).normal(0, 0, 1).end();
+    builder.vertex(1, 1, 0, 1).uv(1, 1).normal(0, 0, 1).end();
+    for (uint32_t i = 0; i < 4; i++) builder.index(i);
+    return builder;
+}
+
+// The golden image of a quad whose pixels land on texel centres: the level itself, pixel for pixel
+static Framebuffer golden(const HostImage& level) {
+    Framebuffer image(level.width, level.height);
+    std::memcpy(image.color.data(), level.pixels.data(), level.pixels.size());
+    return image;
+}
+
+static void matchesTheGolden() {
+    auto texture = gradient(64);
+    auto quad = fullscreenQuad();
+
+    SoftwareRenderer renderer;
+    Framebuffer target(64, 64);
+    renderer.begin(64, 64);
+    renderer.draw(quad, Matrix4::identity(), texture);
+    renderer.finish(target);
+    check(target.difference(golden(texture), 2) == 0, "one texel per pixel matches the texture");
+
+    Framebuffer shifted = golden(texture);
+    shifted.color[0] ^= 0xff;
+    check(target.difference(shifted, 2) == 1, "difference counts a single changed pixel");
+}
+
+static void minifiesFromTheMipChain() {
+    auto texture = gradient(256);
+    auto quad = fullscreenQuad();
+
+    SoftwareRenderer renderer;
+    Framebuffer target(64, 64);
+    renderer.begin(64, 64);
+    renderer.draw(quad, Matrix4::identity(), texture);
+    renderer.finish(target);
+    check(target.difference(golden(texture.downsample().downsample()), 2) == 0,
+        "a quarter size quad samples the second level down");
+}
+
+static void levelsOutliveInvalidation() {
+    auto texture = gradient(256);
+    auto quad = fullscreenQuad();
+    auto expected = golden(texture.downsample().downsample());
+
+    SoftwareRenderer renderer;
+    Framebuffer target(64, 64);
+    renderer.begin(64, 64);
+    renderer.draw(quad, Matrix4::identity(), texture);
+    renderer.invalidate(texture);
+    renderer.finish(target);
+    check(target.difference(expected, 2) == 0, "invalidating before finish keeps queued levels");
+
+    // A redraw after an invalidate rebuilds the chain while the first draw still samples the old
+    target.clear(0, 0, 0, 0);
+    renderer.begin(64, 64);
+    renderer.draw(quad, Matrix4::identity(), texture);
+    renderer.invalidate(texture);
+    renderer.draw(quad, Matrix4::identity(), texture);
+    renderer.finish(target);
+    check(target.difference(expected, 2) == 0, "a rebuilt chain leaves the queued one intact");
+}
+
+int main() {
+    matchesTheGolden();
+    minifiesFromTheMipChain();
+    levelsOutliveInvalidation();
+
+    return report("SoftwareRenderer");
+}
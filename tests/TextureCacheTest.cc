@@ -0,0 +1,144 @@
+#include "Check.h"
+
+#include "../TextureCache.h"
+
+#include <iostream>
+#include <map>
+
+// Hands out ids and remembers the size of every live texture, without a GL context
+struct StubBackend : TextureBackend {
+    std::map<GLuint, std::pair<int, int>> live;
+    GLuint next = 1;
+    int creates = 0;
+    int reductions = 0;
+
+    GLuint create(const HostImage& image) override {
+        creates++;
+        live[next] = {image.width, image.height};
+        return next++;
+    }
+
+    void destroy(GLuint id) override { live.erase(id); }
+
+    GLuint reduce(GLuint id, int width, int height) override {
+        reductions++;
+        auto found = live.find(id);
+        if (found == live.end() || found->second != std::pair(width, height)) return 0;
+
+        HostImage level;
+        level.width = std::max(1, width / 2);
+        level.height = std::max(1, height / 2);
+        return create(level);
+    }
+};
+
+// Serves solid images by path and counts how often each one is loaded
+struct StubLoader {
+    std::map<std::string, std::pair<int, uint8_t>> images;
+    std::map<std::string, int> loads;
+
+    TextureCache::Loader function() {
+        return [this](const std::string& path) -> std::optional<HostImage> {
+            auto found = images.find(path);
+            if (found == images.end()) return std::nullopt;
+            loads[path]++;
+
+            HostImage image;
+            image.width = image.height = found->second.first;
+            image.pixels.assign(static_cast<size_t>(image.width) * image.height * 4,
+                found->second.second);
+            return image;
+        };
+    }
+};
+
+static size_t sizeWithMips(int size) {
+    HostImage shape;
+    shape.width = shape.height = size;
+    return shape.byteSizeWithMips();
+}
+
+static void deduplicates() {
+    StubBackend backend;
+    StubLoader loader;
+    loader.images = {{"a", {64, 1}}, {"b", {64, 1}}, {"c", {64, 2}}};
+    TextureCache cache(backend, 1 << 20, loader.function());
+
+    auto a = cache.acquire("a");
+    auto again = cache.acquire("a");
+    auto b = cache.acquire("b");
+    auto c = cache.acquire("c");
+    check(a && again && b && c, "images load");
+    check(loader.loads["a"] == 1, "a path is loaded once");
+    check(backend.creates == 2, "identical content shares one texture");
+    check(cache.use(a) == cache.use(b) && cache.use(a) != cache.use(c), "ids follow the content");
+    check(cache.bytesUsed() == 2 * sizeWithMips(64), "usage counts each texture once");
+    check(!cache.acquire("missing"), "a failed load gives an empty handle");
+}
+
+static void evictsUnreferencedFirst() {
+    StubBackend backend;
+    StubLoader loader;
+    loader.images = {{"a", {64, 1}}, {"b", {64, 2}}, {"c", {64, 3}}};
+    TextureCache cache(backend, 2 * sizeWithMips(64), loader.function());
+
+    cache.acquire("a");
+    cache.endFrame();
+    auto b = cache.acquire("b");
+    cache.endFrame();
+    auto c = cache.acquire("c");
+    check(cache.bytesUsed() <= cache.bytesBudget(), "the budget is kept");
+    check(backend.live.size() == 2, "the unreferenced texture is freed");
+    check(cache.droppedLevels(b) == 0 && cache.droppedLevels(c) == 0, "no referenced level drops");
+}
+
+static void dropsLevelsWithoutReloading() {
+    StubBackend backend;
+    StubLoader loader;
+    loader.images = {{"big", {256, 1}}, {"new", {256, 2}}};
+    TextureCache cache(backend, sizeWithMips(256) + sizeWithMips(32), loader.function());
+
+    auto big = cache.acquire("big");
+    cache.endFrame();
+    auto fresh = cache.acquire("new");
+    check(cache.bytesUsed() <= cache.bytesBudget(), "dropping levels meets the budget");
+    check(cache.droppedLevels(big) == 3, "the older texture drops down to 32 pixels");
+    check(loader.loads["big"] == 1, "dropped levels come from the gpu copy, not the loader");
+    check(backend.reductions == 3, "one reduction per dropped level");
+    check(backend.live[cache.use(big)] == std::pair(32, 32), "the backend holds the reduced size");
+
+    // Freeing the newer texture leaves room to restore the full chain on the next use
+    fresh = TextureHandle();
+    cache.setBudget(2 * sizeWithMips(256));
+    cache.endFrame();
+    cache.use(big);
+    check(cache.droppedLevels(big) == 0, "levels return once the budget has room");
+    check(loader.loads["big"] == 2, "restoring reloads the source");
+}
+
+static void evictsAtTheMinimumSize() {
+    StubBackend backend;
+    StubLoader loader;
+    loader.images = {{"a", {64, 1}}, {"b", {64, 2}}};
+    TextureCache cache(backend, sizeWithMips(64) + sizeWithMips(8), loader.function());
+
+    auto a = cache.acquire("a");
+    cache.endFrame();
+    auto b = cache.acquire("b");
+    check(!cache.isResident(a), "a referenced texture is evicted below the minimum size");
+    check(cache.droppedLevels(a) == 2, "it kept the levels dropped before eviction");
+
+    cache.endFrame();
+    check(cache.use(a) != 0 && cache.isResident(a), "an evicted texture reloads on use");
+    check(backend.live[cache.use(a)] == std::pair(16, 16), "it reloads at its dropped size");
+    check(cache.bytesUsed() <= cache.bytesBudget(), "the reload stays within budget");
+}
+
+int main() {
+    deduplicates();
+    evictsUnreferencedFirst();
+    dropsLevelsWithoutReloading();
+    evictsAtTheMinimumSize();
+
+    return report("TextureCache");
+}
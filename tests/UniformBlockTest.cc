@@ -0,0 +1,61 @@
+#include "Check.h"
+
+#include "../UniformBlock.h"
+
+#include <iostream>
+
+// Layouts from the std140 rules, the offsets are checked at compile time
+struct Mixed {
+    float a;
+    Vector3 b;
+    float c;
+    Vector2 d;
+    Matrix4 e;
+    std::array<float, 3> f;
+};
+
+using MixedBlock =
+    UniformBlock<Mixed, &Mixed::a, &Mixed::b, &Mixed::c, &Mixed::d, &Mixed::e, &Mixed::f>;
+
+static_assert(MixedBlock::offset<0>() == 0);
+static_assert(MixedBlock::offset<1>() == 16);
+static_assert(MixedBlock::offset<2>() == 28);
+static_assert(MixedBlock::offset<3>() == 32);
+static_assert(MixedBlock::offset<4>() == 48);
+static_assert(MixedBlock::offset<5>() == 112);
+static_assert(MixedBlock::size() == 160);
+
+static float at(const uint8_t* data, size_t offset) {
+    float value;
+    std::memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+static void writesAtTheOffsets() {
+    Mixed value;
+    value.a = 1;
+    value.b = Vector3(2, 3, 4);
+    value.c = 5;
+    value.d = Vector2(6, 7);
+    for (int i = 0; i < 16; i++) value.e.data[i] = 10.0f + i;
+    value.f = {20, 21, 22};
+
+    uint8_t data[MixedBlock::size()];
+    std::memset(data, 0xff, sizeof(data));
+    MixedBlock::write(data, value);
+
+    check(at(data, 0) == 1 && at(data, 4) == 0, "scalar then padding up to the vec3");
+    check(at(data, 16) == 2 && at(data, 24) == 4, "vec3 starts on a vec4 boundary");
+    check(at(data, 28) == 5, "a scalar packs into the vec3's fourth slot");
+    check(at(data, 32) == 6 && at(data, 36) == 7, "vec2 follows on an 8 byte boundary");
+    check(at(data, 48) == 10 && at(data, 52) == 14, "the matrix is written as columns");
+    check(at(data, 112) == 20 && at(data, 128) == 21 && at(data, 144) == 22,
+        "array elements are padded to a vec4 stride");
+    check(at(data, 116) == 0, "array padding is zeroed");
+}
+
+int main() {
+    writesAtTheOffsets();
+
+    return report("UniformBlock");
+}